@@ -0,0 +1,95 @@
+#include "async_search_server.h"
+
+using namespace std;
+
+QueryRejectedError::QueryRejectedError()
+        : runtime_error("Очередь запросов заполнена, запрос отклонён") {
+}
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, size_t max_queue_depth, size_t thread_count)
+        : search_server_(search_server)
+        , max_queue_depth_(max_queue_depth)
+        , pool_(thread_count) {
+}
+
+future<vector<Document>> AsyncSearchServer::FindTopDocuments(string raw_query, DocumentStatus status, shared_ptr<CancellationToken> cancellation, size_t top_count) {
+    auto result = make_shared<promise<vector<Document>>>();
+    future<vector<Document>> documents = result->get_future();
+    const bool is_admitted = FindTopDocuments(move(raw_query), status, move(cancellation), [result](exception_ptr error, vector<Document> documents) {
+        if (error) {
+            result->set_exception(error);
+        } else {
+            result->set_value(move(documents));
+        }
+    }, top_count);
+    if (!is_admitted) {
+        throw QueryRejectedError();
+    }
+    return documents;
+}
+
+bool AsyncSearchServer::FindTopDocuments(string raw_query, DocumentStatus status, shared_ptr<CancellationToken> cancellation, Callback callback,
+                                         size_t top_count) {
+    if (!TryAdmit()) {
+        return false;
+    }
+    if (!cancellation) {
+        cancellation = make_shared<CancellationToken>();
+    }
+    const auto admitted_at = CancellationToken::Clock::now();
+    pool_.Submit([this, raw_query = move(raw_query), status, cancellation = move(cancellation), callback = move(callback), top_count, admitted_at] {
+        queue_depth_.fetch_sub(1, memory_order_relaxed);
+        RecordWait(CancellationToken::Clock::now() - admitted_at);
+
+        exception_ptr error;
+        vector<Document> documents;
+        try {
+            if (cancellation->IsCancelled()) {
+                throw QueryCancelledError();
+            }
+            documents = search_server_.FindTopDocuments(raw_query, StatusIs{status}, top_count, *cancellation);
+        } catch (const QueryCancelledError&) {
+            cancelled_count_.fetch_add(1, memory_order_relaxed);
+            error = current_exception();
+        } catch (...) {
+            error = current_exception();
+        }
+        // Задачи пула не должны бросать исключений
+        try {
+            callback(error, move(documents));
+        } catch (...) {
+        }
+    });
+    return true;
+}
+
+AsyncQueryMetrics AsyncSearchServer::GetMetrics() const {
+    AsyncQueryMetrics metrics;
+    metrics.queue_depth = queue_depth_.load(memory_order_relaxed);
+    metrics.admitted_count = admitted_count_.load(memory_order_relaxed);
+    metrics.rejected_count = rejected_count_.load(memory_order_relaxed);
+    metrics.cancelled_count = cancelled_count_.load(memory_order_relaxed);
+    metrics.total_wait_time = chrono::nanoseconds(total_wait_nanoseconds_.load(memory_order_relaxed));
+    metrics.max_wait_time = chrono::nanoseconds(max_wait_nanoseconds_.load(memory_order_relaxed));
+    return metrics;
+}
+
+bool AsyncSearchServer::TryAdmit() {
+    size_t depth = queue_depth_.load(memory_order_relaxed);
+    do {
+        if (depth >= max_queue_depth_) {
+            rejected_count_.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+    } while (!queue_depth_.compare_exchange_weak(depth, depth + 1, memory_order_relaxed));
+    admitted_count_.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void AsyncSearchServer::RecordWait(chrono::nanoseconds wait_time) {
+    const int64_t wait_nanoseconds = wait_time.count();
+    total_wait_nanoseconds_.fetch_add(wait_nanoseconds, memory_order_relaxed);
+    int64_t max_wait = max_wait_nanoseconds_.load(memory_order_relaxed);
+    while (wait_nanoseconds > max_wait && !max_wait_nanoseconds_.compare_exchange_weak(max_wait, wait_nanoseconds, memory_order_relaxed)) {
+    }
+}
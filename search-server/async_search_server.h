@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cancellation.h"
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+struct AsyncQueryMetrics {
+    // Запросы, принятые, но ещё не начатые
+    size_t queue_depth = 0;
+    uint64_t admitted_count = 0;
+    uint64_t rejected_count = 0;
+    // Отменённые и просроченные, в очереди или во время поиска
+    uint64_t cancelled_count = 0;
+    // Ожидание в очереди: от приёма запроса до начала поиска
+    std::chrono::nanoseconds total_wait_time{0};
+    std::chrono::nanoseconds max_wait_time{0};
+};
+
+class QueryRejectedError : public std::runtime_error {
+public:
+    QueryRejectedError();
+};
+
+// Асинхронный вход для запросов к индексу. В очереди не больше max_queue_depth ещё не начатых
+// запросов, сверх этого запросы сразу отклоняются. Срок запроса включает ожидание в очереди:
+// запрос, чей срок истёк до начала, не выполняется, а начатый прерывается в циклах подсчёта
+// релевантности. Индекс не должен меняться, пока есть незавершённые запросы
+class AsyncSearchServer {
+public:
+    using Callback = std::function<void(std::exception_ptr error, std::vector<Document> documents)>;
+
+    AsyncSearchServer(const SearchServer& search_server, size_t max_queue_depth,
+                      size_t thread_count = std::thread::hardware_concurrency());
+
+    // Бросает QueryRejectedError, если очередь заполнена. Отменённый запрос завершает future
+    // исключением QueryCancelledError. cancellation может быть nullptr — запрос без срока
+    std::future<std::vector<Document>> FindTopDocuments(std::string raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                                        std::shared_ptr<CancellationToken> cancellation = nullptr,
+                                                        size_t top_count = MAX_RESULT_DOCUMENT_COUNT);
+    // Вызывает callback в потоке пула с ошибкой или результатом. false — запрос отклонён
+    // и callback вызван не будет
+    bool FindTopDocuments(std::string raw_query, DocumentStatus status, std::shared_ptr<CancellationToken> cancellation, Callback callback,
+                          size_t top_count = MAX_RESULT_DOCUMENT_COUNT);
+
+    AsyncQueryMetrics GetMetrics() const;
+
+private:
+    const SearchServer& search_server_;
+    const size_t max_queue_depth_;
+
+    std::atomic<size_t> queue_depth_{0};
+    std::atomic<uint64_t> admitted_count_{0};
+    std::atomic<uint64_t> rejected_count_{0};
+    std::atomic<uint64_t> cancelled_count_{0};
+    std::atomic<int64_t> total_wait_nanoseconds_{0};
+    std::atomic<int64_t> max_wait_nanoseconds_{0};
+
+    // Объявлен последним: при уничтожении пул дожидается задач, которые обращаются к полям выше
+    ThreadPool pool_;
+
+    bool TryAdmit();
+    void RecordWait(std::chrono::nanoseconds wait_time);
+};
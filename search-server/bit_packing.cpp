@@ -0,0 +1,115 @@
+#include "bit_packing.h"
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+const size_t LANE_COUNT = 4;
+const size_t ROW_COUNT = BIT_PACKING_BLOCK_SIZE / LANE_COUNT;
+
+#ifndef __SSE2__
+void PackLane(const uint32_t* values, int bit_width, uint32_t* out) {
+    uint64_t acc = 0;
+    int shift = 0;
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+        acc |= static_cast<uint64_t>(values[row * LANE_COUNT]) << shift;
+        shift += bit_width;
+        if (shift >= 32) {
+            *out = static_cast<uint32_t>(acc);
+            out += LANE_COUNT;
+            acc >>= 32;
+            shift -= 32;
+        }
+    }
+}
+
+void UnpackLane(const uint32_t* in, int bit_width, uint32_t* values) {
+    const uint64_t mask = (uint64_t{1} << bit_width) - 1;
+    uint64_t acc = 0;
+    int available = 0;
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+        if (available < bit_width) {
+            acc |= static_cast<uint64_t>(*in) << available;
+            in += LANE_COUNT;
+            available += 32;
+        }
+        values[row * LANE_COUNT] = static_cast<uint32_t>(acc & mask);
+        acc >>= bit_width;
+        available -= bit_width;
+    }
+}
+#endif
+}
+
+int RequiredBitWidth(const uint32_t* values, size_t count) {
+    uint32_t accumulated = 0;
+    for (size_t i = 0; i < count; ++i) {
+        accumulated |= values[i];
+    }
+    int bit_width = 0;
+    while (bit_width < 32 && (accumulated >> bit_width) != 0) {
+        ++bit_width;
+    }
+    return bit_width;
+}
+
+size_t PackBlock(const uint32_t* values, int bit_width, uint32_t* out) {
+    if (bit_width == 0) {
+        return 0;
+    }
+#ifdef __SSE2__
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+    __m128i acc = _mm_setzero_si128();
+    int shift = 0;
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + row * LANE_COUNT));
+        acc = _mm_or_si128(acc, _mm_sll_epi32(value, _mm_cvtsi32_si128(shift)));
+        shift += bit_width;
+        if (shift >= 32) {
+            _mm_storeu_si128(dst++, acc);
+            shift -= 32;
+            acc = shift > 0 ? _mm_srl_epi32(value, _mm_cvtsi32_si128(bit_width - shift)) : _mm_setzero_si128();
+        }
+    }
+#else
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        PackLane(values + lane, bit_width, out + lane);
+    }
+#endif
+    return LANE_COUNT * bit_width;
+}
+
+void UnpackBlock(const uint32_t* in, int bit_width, uint32_t* values) {
+    if (bit_width == 0) {
+        fill(values, values + BIT_PACKING_BLOCK_SIZE, 0);
+        return;
+    }
+#ifdef __SSE2__
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    const __m128i mask = _mm_set1_epi32(bit_width == 32 ? ~0u : (1u << bit_width) - 1);
+    __m128i current = _mm_loadu_si128(src++);
+    int shift = 0;
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(shift));
+        shift += bit_width;
+        if (shift > 32) {
+            // Значение разрезано между двумя словами полосы
+            current = _mm_loadu_si128(src++);
+            shift -= 32;
+            value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(bit_width - shift)));
+        } else if (shift == 32 && row + 1 < ROW_COUNT) {
+            current = _mm_loadu_si128(src++);
+            shift = 0;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + row * LANE_COUNT), _mm_and_si128(value, mask));
+    }
+#else
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        UnpackLane(in + lane, bit_width, values + lane);
+    }
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Упаковка блоков по 128 целых в вертикальной раскладке SIMD-BP128: значение i хранится
+// в полосе i % 4, так что четыре полосы упаковываются одной SSE2-инструкцией.
+// Без SSE2 используется скалярная реализация с той же раскладкой
+const size_t BIT_PACKING_BLOCK_SIZE = 128;
+
+// Наименьшая ширина в битах, в которую помещаются все значения
+int RequiredBitWidth(const uint32_t* values, size_t count);
+
+// Упаковывает BIT_PACKING_BLOCK_SIZE значений, каждое меньше 2^bit_width,
+// и возвращает число записанных 32-битных слов (4 * bit_width)
+size_t PackBlock(const uint32_t* values, int bit_width, uint32_t* out);
+
+void UnpackBlock(const uint32_t* in, int bit_width, uint32_t* values);
@@ -0,0 +1,31 @@
+#include "cancellation.h"
+
+using namespace std;
+
+CancellationToken::CancellationToken(Clock::time_point deadline)
+        : deadline_(deadline) {
+}
+
+void CancellationToken::Cancel() {
+    is_cancelled_.store(true, memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    if (is_cancelled_.load(memory_order_relaxed)) {
+        return true;
+    }
+    if (deadline_ != Clock::time_point::max() && Clock::now() >= deadline_) {
+        // Запоминается, чтобы следующие проверки не обращались к часам
+        is_cancelled_.store(true, memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+CancellationToken::Clock::time_point CancellationToken::GetDeadline() const {
+    return deadline_;
+}
+
+QueryCancelledError::QueryCancelledError()
+        : runtime_error("Запрос отменён или истёк его срок") {
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+// Отмена запроса: явная, через Cancel, или по истечении срока. Поиск проверяет отмену
+// в циклах по спискам вхождений и прерывается исключением QueryCancelledError
+class CancellationToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CancellationToken() = default;
+    explicit CancellationToken(Clock::time_point deadline);
+
+    void Cancel();
+    // Отменён или истёк срок
+    bool IsCancelled() const;
+    Clock::time_point GetDeadline() const;
+
+private:
+    mutable std::atomic<bool> is_cancelled_{false};
+    Clock::time_point deadline_ = Clock::time_point::max();
+};
+
+class QueryCancelledError : public std::runtime_error {
+public:
+    QueryCancelledError();
+};
@@ -0,0 +1,104 @@
+#include "compressed_posting_list.h"
+#include <algorithm>
+
+using namespace std;
+
+CompressedPostingList::CompressedPostingList(const vector<uint32_t>& slots, const vector<uint32_t>& term_counts)
+        : size_(slots.size()) {
+    uint32_t deltas[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    uint32_t previous_slot = 0;
+    for (size_t start = 0; start < size_; start += BLOCK_SIZE) {
+        const size_t count = min(BLOCK_SIZE, size_ - start);
+        fill(deltas, deltas + BLOCK_SIZE, 0);
+        fill(counts, counts + BLOCK_SIZE, 0);
+        for (size_t i = 0; i < count; ++i) {
+            deltas[i] = slots[start + i] - previous_slot;
+            // Слово встречается в документе хотя бы раз, так что в большинстве блоков здесь нули
+            counts[i] = term_counts[start + i] - 1;
+            previous_slot = slots[start + i];
+        }
+
+        BlockInfo info;
+        info.last_slot = previous_slot;
+        info.offset = static_cast<uint32_t>(data_.size());
+        info.slot_bits = static_cast<uint8_t>(RequiredBitWidth(deltas, count));
+        info.count_bits = static_cast<uint8_t>(RequiredBitWidth(counts, count));
+        data_.resize(data_.size() + 4 * (info.slot_bits + info.count_bits));
+
+        uint32_t* out = data_.data() + info.offset;
+        out += PackBlock(deltas, info.slot_bits, out);
+        PackBlock(counts, info.count_bits, out);
+        blocks_.push_back(info);
+    }
+    data_.shrink_to_fit();
+}
+
+size_t CompressedPostingList::size() const {
+    return size_;
+}
+
+size_t CompressedPostingList::GetBlockCount() const {
+    return blocks_.size();
+}
+
+uint32_t CompressedPostingList::GetBlockLastSlot(size_t block) const {
+    return blocks_[block].last_slot;
+}
+
+size_t CompressedPostingList::FindBlock(uint32_t slot, size_t first_block) const {
+    return partition_point(blocks_.begin() + first_block, blocks_.end(), [slot](const BlockInfo& info) {
+        return info.last_slot < slot;
+    }) - blocks_.begin();
+}
+
+size_t CompressedPostingList::DecodeSlots(size_t block, uint32_t* slots) const {
+    const BlockInfo& info = blocks_[block];
+    UnpackBlock(data_.data() + info.offset, info.slot_bits, slots);
+    const size_t count = GetBlockSize(block);
+    uint32_t slot = block == 0 ? 0 : blocks_[block - 1].last_slot;
+    for (size_t i = 0; i < count; ++i) {
+        slot += slots[i];
+        slots[i] = slot;
+    }
+    return count;
+}
+
+size_t CompressedPostingList::DecodeBlock(size_t block, const uint32_t* word_counts, uint32_t* slots, double* term_freqs) const {
+    const size_t count = DecodeSlots(block, slots);
+    const BlockInfo& info = blocks_[block];
+    uint32_t counts[BLOCK_SIZE];
+    UnpackBlock(data_.data() + info.offset + 4 * info.slot_bits, info.count_bits, counts);
+    for (size_t i = 0; i < count; ++i) {
+        term_freqs[i] = ComputeTermFreq(counts[i] + 1, word_counts[slots[i]]);
+    }
+    return count;
+}
+
+bool CompressedPostingList::Contains(uint32_t slot) const {
+    const size_t block = FindBlock(slot);
+    if (block == blocks_.size()) {
+        return false;
+    }
+    uint32_t slots[BLOCK_SIZE];
+    const size_t count = DecodeSlots(block, slots);
+    return binary_search(slots, slots + count, slot);
+}
+
+size_t CompressedPostingList::GetMemoryUsage() const {
+    return blocks_.capacity() * sizeof(BlockInfo) + data_.capacity() * sizeof(uint32_t);
+}
+
+double CompressedPostingList::ComputeTermFreq(uint32_t term_count, uint32_t word_count) {
+    // Та же последовательность сложений, что и в AddDocument, — результат совпадает до бита
+    const double inv_word_count = 1.0 / word_count;
+    double term_freq = 0.0;
+    for (uint32_t i = 0; i < term_count; ++i) {
+        term_freq += inv_word_count;
+    }
+    return term_freq;
+}
+
+size_t CompressedPostingList::GetBlockSize(size_t block) const {
+    return min(BLOCK_SIZE, size_ - block * BLOCK_SIZE);
+}
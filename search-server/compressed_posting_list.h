@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_packing.h"
+
+// Сжатый неизменяемый список вхождений. Вхождения разбиты на блоки по 128: в блоке хранятся
+// упакованные разности соседних слотов и число вхождений слова в документ. Длины документов
+// в списке не хранятся — они передаются при распаковке колонкой по слотам, и частота слова
+// восстанавливается из числа вхождений и длины точно так же, как её считает AddDocument.
+// Для каждого блока хранится последний слот, поэтому при поиске блоки пропускаются без распаковки
+class CompressedPostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = BIT_PACKING_BLOCK_SIZE;
+
+    CompressedPostingList() = default;
+    // slots отсортированы по возрастанию, term_counts[i] — сколько раз слово встречается в документе slots[i]
+    CompressedPostingList(const std::vector<uint32_t>& slots, const std::vector<uint32_t>& term_counts);
+
+    size_t size() const;
+    size_t GetBlockCount() const;
+    uint32_t GetBlockLastSlot(size_t block) const;
+    // Первый блок начиная с first_block, последний слот которого не меньше slot, иначе GetBlockCount()
+    size_t FindBlock(uint32_t slot, size_t first_block = 0) const;
+
+    // Распаковывают блок в буферы размера BLOCK_SIZE и возвращают число вхождений в нём;
+    // word_counts — число слов документа по слотам
+    size_t DecodeSlots(size_t block, uint32_t* slots) const;
+    size_t DecodeBlock(size_t block, const uint32_t* word_counts, uint32_t* slots, double* term_freqs) const;
+
+    bool Contains(uint32_t slot) const;
+    size_t GetMemoryUsage() const;
+
+    static double ComputeTermFreq(uint32_t term_count, uint32_t word_count);
+
+private:
+    struct BlockInfo {
+        uint32_t last_slot;
+        uint32_t offset;
+        uint8_t slot_bits;
+        uint8_t count_bits;
+    };
+
+    std::vector<BlockInfo> blocks_;
+    std::vector<uint32_t> data_;
+    size_t size_ = 0;
+
+    size_t GetBlockSize(size_t block) const;
+};
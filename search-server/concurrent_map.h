@@ -1,58 +1,316 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
+#include <execution>
 #include <map>
 #include <mutex>
+#include <numeric>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 using namespace std::string_literals;
 
+// Хеш-таблица с открытой адресацией без блокировок: потоки добавляют значения атомарно,
+// не конкурируя за мьютексы. Таблица рассчитана на ожидаемое число ключей; ключ, которому не нашлось
+// места за MAX_PROBE_COUNT проб, попадает в общую область переполнения под мьютексом,
+// так что число ключей не ограничено — лишние лишь добавляются медленнее.
+// Арифметические значения складываются атомарно; значение другого типа меняется только
+// под спин-блокировкой своей ячейки, как при доступе через operator[]
 template <typename Key, typename Value>
 class ConcurrentMap {
 private:
-    struct Bucket {
-        std::mutex mutex;
-        std::map<Key, Value> map;
-    };
+    struct Entry;
 
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
+    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
 
-    struct Access {
-        std::lock_guard<std::mutex> guard;
+    // Доступ к значению ключа в прежнем виде: map[key].ref_to_value += delta. Доступы к одному ключу
+    // выполняются по очереди, а изменение значения прибавляется к нему при разрушении Access,
+    // поэтому складывается с параллельными Add
+    class Access {
+    public:
         Value& ref_to_value;
 
-        Access(const Key& key, Bucket& bucket)
-                : guard(bucket.mutex)
-                , ref_to_value(bucket.map[key]) {
+        Access(const Access&) = delete;
+        Access& operator=(const Access&) = delete;
+
+        ~Access() {
+            if (entry_ == nullptr) {
+                return;
+            }
+            if constexpr (IS_ATOMIC_VALUE) {
+                const Value delta = current_ - initial_;
+                if (delta != Value{}) {
+                    AddToEntry(*entry_, delta);
+                }
+            }
+            UnlockEntry(*entry_);
+        }
+
+    private:
+        friend class ConcurrentMap;
+
+        // Значение ключа из области переполнения, которую держит lock
+        Access(Value& value, std::unique_lock<std::mutex> lock)
+                : ref_to_value(value)
+                , lock_(std::move(lock)) {
+        }
+
+        // Атомарное значение копируется, а неатомарное изменяется на месте, пока ячейка заблокирована
+        explicit Access(Entry& entry)
+                : ref_to_value(SelectValue(entry))
+                , entry_(&entry) {
+            LockEntry(entry);
+            entry.is_present.store(true, std::memory_order_relaxed);
+            if constexpr (IS_ATOMIC_VALUE) {
+                initial_ = entry.value.load(std::memory_order_relaxed);
+                current_ = initial_;
+            }
         }
+
+        Value& SelectValue(Entry& entry) {
+            if constexpr (IS_ATOMIC_VALUE) {
+                return current_;
+            } else {
+                return entry.value;
+            }
+        }
+
+        Entry* entry_ = nullptr;
+        Value initial_{};
+        Value current_{};
+        std::unique_lock<std::mutex> lock_;
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-            : buckets_(bucket_count) {
+    // size_hint — ожидаемое число ключей. Прежнее значение bucket_count тоже подходит:
+    // таблица получится меньше, но ключи, которым не хватит места, уйдут в область переполнения
+    explicit ConcurrentMap(size_t size_hint)
+            : entries_(ComputeCapacity(size_hint))
+            , mask_(entries_.size() - 1) {
+        while ((size_t{1} << (64 - shift_)) < entries_.size()) {
+            --shift_;
+        }
     }
 
     Access operator[](const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return {key, bucket};
+        Entry* entry = FindOrInsert(key);
+        if (entry == nullptr) {
+            std::unique_lock lock(overflow_mutex_);
+            Value& value = overflow_[key];
+            return Access(value, std::move(lock));
+        }
+        return Access(*entry);
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (auto& [mutex, map] : buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+    // Прибавляет delta к значению ключа, создавая ключ при первом обращении
+    void Add(const Key& key, const Value& delta) {
+        Entry* entry = FindOrInsert(key);
+        if (entry == nullptr) {
+            std::lock_guard lock(overflow_mutex_);
+            overflow_[key] += delta;
+            return;
+        }
+        if constexpr (IS_ATOMIC_VALUE) {
+            entry->is_present.store(true, std::memory_order_relaxed);
+            AddToEntry(*entry, delta);
+        } else {
+            LockEntry(*entry);
+            entry->is_present.store(true, std::memory_order_relaxed);
+            entry->value += delta;
+            UnlockEntry(*entry);
         }
-        return result;
     }
 
     void erase(const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        Access temp(key, bucket);
-        bucket.map.erase(key);
+        bool is_overflow = false;
+        Entry* entry = Find(key, is_overflow);
+        if (entry != nullptr) {
+            if constexpr (IS_ATOMIC_VALUE) {
+                entry->is_present.store(false, std::memory_order_relaxed);
+                entry->value.store(Value{}, std::memory_order_relaxed);
+            } else {
+                LockEntry(*entry);
+                entry->is_present.store(false, std::memory_order_relaxed);
+                entry->value = Value{};
+                UnlockEntry(*entry);
+            }
+        } else if (is_overflow) {
+            std::lock_guard lock(overflow_mutex_);
+            overflow_.erase(key);
+        }
+    }
+
+    // Собирает содержимое в вектор, обходя таблицу частями параллельно.
+    // Вызывается, когда добавления и удаления завершены
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> BuildVector(ExecutionPolicy policy) const {
+        const size_t chunk_count = (entries_.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        std::vector<size_t> chunks(chunk_count);
+        std::iota(chunks.begin(), chunks.end(), 0);
+
+        std::vector<size_t> offsets(chunk_count + 1, 0);
+        std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+            offsets[chunk + 1] = std::count_if(ChunkBegin(chunk), ChunkEnd(chunk), [](const Entry& entry) {
+                return entry.is_present.load(std::memory_order_relaxed);
+            });
+        });
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::lock_guard lock(overflow_mutex_);
+        std::vector<std::pair<Key, Value>> result(offsets.back() + overflow_.size());
+        std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+            size_t pos = offsets[chunk];
+            for (auto it = ChunkBegin(chunk); it != ChunkEnd(chunk); ++it) {
+                if (it->is_present.load(std::memory_order_relaxed)) {
+                    result[pos++] = {it->key, LoadValue(*it)};
+                }
+            }
+        });
+        std::copy(overflow_.begin(), overflow_.end(), result.begin() + offsets.back());
+        return result;
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        const auto entries = BuildVector(std::execution::seq);
+        return {entries.begin(), entries.end()};
     }
 
 private:
-    std::vector<Bucket> buckets_;
-};
\ No newline at end of file
+    static constexpr bool IS_ATOMIC_VALUE = std::is_arithmetic_v<Value>;
+
+    enum EntryState : uint8_t {
+        EMPTY,
+        WRITING,
+        READY,
+    };
+
+    struct Entry {
+        std::atomic<uint8_t> state{EMPTY};
+        std::atomic<bool> is_present{false};
+        // Занят Access или изменением неатомарного значения
+        std::atomic<bool> is_locked{false};
+        Key key{};
+        std::conditional_t<IS_ATOMIC_VALUE, std::atomic<Value>, Value> value{};
+    };
+
+    static const size_t CHUNK_SIZE = 4096;
+    // Длина цепочки проб, после которой ключ уходит в область переполнения
+    static const size_t MAX_PROBE_COUNT = 128;
+    // Сколько раз ожидание ключа крутится впустую, прежде чем уступать процессор
+    static const int SPIN_COUNT = 64;
+
+    std::vector<Entry> entries_;
+    size_t mask_;
+    int shift_ = 64;
+    mutable std::mutex overflow_mutex_;
+    std::map<Key, Value> overflow_;
+
+    static void LockEntry(Entry& entry) {
+        while (entry.is_locked.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    static void UnlockEntry(Entry& entry) {
+        entry.is_locked.store(false, std::memory_order_release);
+    }
+
+    static Value LoadValue(const Entry& entry) {
+        if constexpr (IS_ATOMIC_VALUE) {
+            return entry.value.load(std::memory_order_relaxed);
+        } else {
+            return entry.value;
+        }
+    }
+
+    static void AddToEntry(Entry& entry, const Value& delta) {
+        if constexpr (std::is_integral_v<Value>) {
+            entry.value.fetch_add(delta, std::memory_order_relaxed);
+        } else {
+            Value current = entry.value.load(std::memory_order_relaxed);
+            while (!entry.value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+            }
+        }
+    }
+
+    // Степень двойки, не меньше удвоенного ожидаемого числа ключей
+    static size_t ComputeCapacity(size_t expected_size) {
+        size_t capacity = 16;
+        while (capacity < expected_size * 2) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    size_t GetStartIndex(const Key& key) const {
+        // Фибоначчиево хеширование: старшие биты произведения распределены лучше младших
+        return static_cast<size_t>(static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull >> shift_) & mask_;
+    }
+
+    // Ключ записывается сразу после захвата ячейки, поэтому ожидание короткое
+    static const Key& WaitForKey(const Entry& entry) {
+        for (int spin = 0; entry.state.load(std::memory_order_acquire) != READY; ++spin) {
+            if (spin >= SPIN_COUNT) {
+                std::this_thread::yield();
+            }
+        }
+        return entry.key;
+    }
+
+    size_t GetMaxProbeCount() const {
+        // Без std::min: он принимает ссылки и потребовал бы определения MAX_PROBE_COUNT вне класса
+        return entries_.size() < MAX_PROBE_COUNT ? entries_.size() : MAX_PROBE_COUNT;
+    }
+
+    // nullptr — ключ хранится в области переполнения
+    Entry* FindOrInsert(const Key& key) {
+        size_t index = GetStartIndex(key);
+        for (size_t probe = 0; probe < GetMaxProbeCount(); ++probe, index = (index + 1) & mask_) {
+            Entry& entry = entries_[index];
+            uint8_t state = entry.state.load(std::memory_order_acquire);
+            if (state == EMPTY) {
+                if (entry.state.compare_exchange_strong(state, WRITING, std::memory_order_acq_rel)) {
+                    entry.key = key;
+                    entry.state.store(READY, std::memory_order_release);
+                    return &entry;
+                }
+            }
+            if (WaitForKey(entry) == key) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // Занятые ячейки не освобождаются, поэтому пустая ячейка в цепочке проб означает, что ключа нет;
+    // цепочка без пустых ячеек — что ключ может быть в области переполнения
+    Entry* Find(const Key& key, bool& is_overflow) {
+        is_overflow = false;
+        size_t index = GetStartIndex(key);
+        for (size_t probe = 0; probe < GetMaxProbeCount(); ++probe, index = (index + 1) & mask_) {
+            Entry& entry = entries_[index];
+            if (entry.state.load(std::memory_order_acquire) == EMPTY) {
+                return nullptr;
+            }
+            if (WaitForKey(entry) == key) {
+                return &entry;
+            }
+        }
+        is_overflow = true;
+        return nullptr;
+    }
+
+    auto ChunkBegin(size_t chunk) const {
+        return entries_.begin() + chunk * CHUNK_SIZE;
+    }
+
+    auto ChunkEnd(size_t chunk) const {
+        return entries_.begin() + std::min((chunk + 1) * CHUNK_SIZE, entries_.size());
+    }
+};
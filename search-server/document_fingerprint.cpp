@@ -0,0 +1,68 @@
+#include "document_fingerprint.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+uint64_t MixBits(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return value;
+}
+
+// Две половины отпечатка считаются независимыми цепочками с разными константами
+void FingerprintBuilder::Add(uint32_t term_id) {
+    low_ = MixBits(low_ ^ (term_id + 0x9E3779B97F4A7C15ull));
+    high_ = MixBits(high_ + term_id * 0xC2B2AE3D27D4EB4Full + 0x165667B19E3779F9ull);
+    ++count_;
+}
+
+DocumentFingerprint FingerprintBuilder::Get() const {
+    return {MixBits(low_ ^ count_), MixBits(high_ + count_ * 0x27D4EB2F165667C5ull)};
+}
+
+namespace {
+
+// Хеш-функция i: старшие 32 бита (x * multiplier + increment) по модулю 2^64 от перемешанного id слова
+struct MinHashCoefficients {
+    std::array<uint64_t, MIN_HASH_SIZE> multipliers;
+    std::array<uint64_t, MIN_HASH_SIZE> increments;
+
+    MinHashCoefficients() {
+        for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+            multipliers[i] = MixBits(2 * i + 1) | 1;
+            increments[i] = MixBits(2 * i + 2);
+        }
+    }
+};
+
+const MinHashCoefficients MIN_HASH_COEFFICIENTS;
+
+}  // namespace
+
+MinHashBuilder::MinHashBuilder() {
+    signature_.fill(numeric_limits<uint32_t>::max());
+}
+
+void MinHashBuilder::Add(uint32_t term_id) {
+    const uint64_t hash = MixBits(term_id);
+    for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+        const uint64_t value = hash * MIN_HASH_COEFFICIENTS.multipliers[i] + MIN_HASH_COEFFICIENTS.increments[i];
+        signature_[i] = min(signature_[i], static_cast<uint32_t>(value >> 32));
+    }
+}
+
+const MinHashSignature& MinHashBuilder::Get() const {
+    return signature_;
+}
+
+double EstimateSimilarity(const MinHashSignature& lhs, const MinHashSignature& rhs) {
+    size_t equal_count = 0;
+    for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+        equal_count += lhs[i] == rhs[i];
+    }
+    return static_cast<double>(equal_count) / MIN_HASH_SIZE;
+}
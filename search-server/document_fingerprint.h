@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// 128-битный отпечаток набора id слов документа. Документы одного индекса с одинаковым
+// набором слов имеют равные отпечатки; совпадение отпечатков у разных наборов практически невозможно
+struct DocumentFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const DocumentFingerprint& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+struct DocumentFingerprintHasher {
+    size_t operator()(const DocumentFingerprint& fingerprint) const {
+        return static_cast<size_t>(fingerprint.low);
+    }
+};
+
+// Строит отпечаток по id слов, переданным по возрастанию и без повторов
+class FingerprintBuilder {
+public:
+    void Add(uint32_t term_id);
+    DocumentFingerprint Get() const;
+
+private:
+    uint64_t low_ = 0;
+    uint64_t high_ = 0;
+    uint64_t count_ = 0;
+};
+
+// Сигнатура MinHash: для каждой из MIN_HASH_SIZE хеш-функций — наименьший хеш слова документа.
+// Доля совпавших значений у двух сигнатур оценивает сходство наборов слов по Жаккару
+const size_t MIN_HASH_SIZE = 64;
+using MinHashSignature = std::array<uint32_t, MIN_HASH_SIZE>;
+
+class MinHashBuilder {
+public:
+    MinHashBuilder();
+
+    void Add(uint32_t term_id);
+    const MinHashSignature& Get() const;
+
+private:
+    MinHashSignature signature_;
+};
+
+double EstimateSimilarity(const MinHashSignature& lhs, const MinHashSignature& rhs);
+
+// Перемешивание битов из splitmix64
+uint64_t MixBits(uint64_t value);
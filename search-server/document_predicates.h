@@ -0,0 +1,32 @@
+#pragma once
+#include "document.h"
+
+// Частые предикаты отбора документов. Это обычные функциональные объекты с сигнатурой
+// (id, status, rating), и их можно передать везде, где ждут предикат. SearchServer
+// распознаёт их при поиске: статус проверяется по битовому множеству слотов со статусом,
+// не читая данных документа, а рейтинг и id — по плотным колонкам рейтингов и id по слотам, без ветвлений
+struct StatusIs {
+    DocumentStatus status;
+
+    bool operator()(int, DocumentStatus document_status, int) const {
+        return document_status == status;
+    }
+};
+
+struct RatingAtLeast {
+    int min_rating;
+
+    bool operator()(int, DocumentStatus, int rating) const {
+        return rating >= min_rating;
+    }
+};
+
+// id из [first, last)
+struct IdInRange {
+    int first;
+    int last;
+
+    bool operator()(int document_id, DocumentStatus, int) const {
+        return (document_id >= first) & (document_id < last);
+    }
+};
@@ -0,0 +1,52 @@
+#include "epoch_manager.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+using namespace std;
+
+EpochManager::Guard::Guard(atomic<uint64_t>* slot)
+        : slot_(slot) {
+}
+
+EpochManager::Guard::Guard(Guard&& other) noexcept
+        : slot_(other.slot_) {
+    other.slot_ = nullptr;
+}
+
+EpochManager::Guard::~Guard() {
+    if (slot_ != nullptr) {
+        slot_->store(0, memory_order_release);
+    }
+}
+
+// Эпоха читается до того, как занять ячейку, поэтому объявленная эпоха может отстать
+// от текущей. Это безопасно: меньшая эпоха лишь откладывает освобождение
+EpochManager::Guard EpochManager::Pin() const {
+    const size_t start = hash<thread::id>{}(this_thread::get_id()) % SLOT_COUNT;
+    while (true) {
+        for (size_t i = 0; i < SLOT_COUNT; ++i) {
+            atomic<uint64_t>& slot = slots_[(start + i) % SLOT_COUNT].epoch;
+            uint64_t expected = 0;
+            if (slot.load(memory_order_relaxed) == 0 && slot.compare_exchange_strong(expected, epoch_.load())) {
+                return Guard(&slot);
+            }
+        }
+        this_thread::yield();
+    }
+}
+
+uint64_t EpochManager::Advance() {
+    return epoch_.fetch_add(1);
+}
+
+uint64_t EpochManager::GetOldestActiveEpoch() const {
+    uint64_t oldest = NO_READERS;
+    for (const Slot& slot : slots_) {
+        const uint64_t epoch = slot.epoch.load();
+        if (epoch != 0) {
+            oldest = min(oldest, epoch);
+        }
+    }
+    return oldest;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Освобождение памяти по эпохам. Читатель на время доступа к разделяемым данным объявляет
+// текущую эпоху в свободной ячейке и ничего не блокирует. Писатель, заменив данные, продвигает
+// эпоху; заменённые данные можно освободить, когда все объявленные эпохи стали больше той,
+// в которой их заменили
+class EpochManager {
+public:
+    static constexpr size_t SLOT_COUNT = 128;
+    static constexpr uint64_t NO_READERS = UINT64_MAX;
+
+    // Объявленная читателем эпоха; снимается в деструкторе
+    class Guard {
+    public:
+        Guard(Guard&& other) noexcept;
+        Guard& operator=(Guard&& other) = delete;
+        ~Guard();
+
+    private:
+        friend class EpochManager;
+        explicit Guard(std::atomic<uint64_t>* slot);
+
+        std::atomic<uint64_t>* slot_;
+    };
+
+    // Занимает ячейку; если все ячейки заняты, ждёт, пока освободится любая
+    Guard Pin() const;
+
+    // Продвигает эпоху и возвращает ту, в которой писатель заменил данные
+    uint64_t Advance();
+    // Наименьшая эпоха среди читателей или NO_READERS. Данные, заменённые в эпоху
+    // меньше результата, уже никто не читает
+    uint64_t GetOldestActiveEpoch() const;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    // Ноль в ячейке означает, что она свободна, поэтому эпохи начинаются с единицы
+    std::atomic<uint64_t> epoch_{1};
+    mutable std::array<Slot, SLOT_COUNT> slots_;
+};
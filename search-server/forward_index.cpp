@@ -0,0 +1,63 @@
+#include "forward_index.h"
+
+using namespace std;
+
+void ForwardIndex::Clear(uint32_t slot) {
+    if (slot < ranges_.size()) {
+        ReleaseSlot(slot) = Range{};
+        CompactIfNeeded();
+    }
+}
+
+ForwardIndex::Entries ForwardIndex::Get(uint32_t slot) const {
+    if (slot >= ranges_.size()) {
+        return {};
+    }
+    const Range& range = ranges_[slot];
+    if (range.is_mapped) {
+        return {mapped_term_ids_ + range.offset, mapped_term_freqs_ + range.offset, range.size};
+    }
+    return {term_ids_.data() + range.offset, term_freqs_.data() + range.offset, range.size};
+}
+
+void ForwardIndex::AttachMapped(const uint64_t* offsets, const uint32_t* term_ids, const double* term_freqs, size_t slot_count) {
+    mapped_term_ids_ = term_ids;
+    mapped_term_freqs_ = term_freqs;
+    ranges_.assign(slot_count, Range{});
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        ranges_[slot] = {offsets[slot], static_cast<uint32_t>(offsets[slot + 1] - offsets[slot]), true};
+    }
+}
+
+ForwardIndex::Range& ForwardIndex::ReleaseSlot(uint32_t slot) {
+    if (slot >= ranges_.size()) {
+        ranges_.resize(slot + 1);
+    }
+    Range& range = ranges_[slot];
+    if (!range.is_mapped) {
+        garbage_size_ += range.size;
+    }
+    return range;
+}
+
+void ForwardIndex::CompactIfNeeded() {
+    if (garbage_size_ < MIN_GARBAGE_TO_COMPACT || garbage_size_ * 2 < term_ids_.size()) {
+        return;
+    }
+    vector<uint32_t> term_ids;
+    vector<double> term_freqs;
+    term_ids.reserve(term_ids_.size() - garbage_size_);
+    term_freqs.reserve(term_ids_.size() - garbage_size_);
+    for (Range& range : ranges_) {
+        if (range.is_mapped) {
+            continue;
+        }
+        const uint64_t offset = term_ids.size();
+        term_ids.insert(term_ids.end(), term_ids_.begin() + range.offset, term_ids_.begin() + range.offset + range.size);
+        term_freqs.insert(term_freqs.end(), term_freqs_.begin() + range.offset, term_freqs_.begin() + range.offset + range.size);
+        range.offset = offset;
+    }
+    term_ids_.swap(term_ids);
+    term_freqs_.swap(term_freqs);
+    garbage_size_ = 0;
+}
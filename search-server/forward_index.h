@@ -0,0 +1,127 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "term_dictionary.h"
+
+// Прямой индекс: слова документов, хранящиеся подряд в двух общих массивах — id слов
+// по возрастанию и их частоты. Документ задаётся слотом, для слота хранится лишь смещение
+// и число слов. Слова удалённых и перезаписанных слотов остаются в массивах, пока их
+// не станет больше живых — тогда массивы переписываются заново.
+// Слова из снимка читаются прямо из отображённого файла
+class ForwardIndex {
+public:
+    struct Entries {
+        const uint32_t* term_ids = nullptr;
+        const double* term_freqs = nullptr;
+        size_t size = 0;
+    };
+
+    // Записывает слова документа в слот; элементы term_freqs — с полями term_id и freq, по возрастанию term_id
+    template <typename TermFreqs>
+    void Set(uint32_t slot, const TermFreqs& term_freqs);
+    void Clear(uint32_t slot);
+    // Указатели действительны до следующего изменения индекса
+    Entries Get(uint32_t slot) const;
+
+    // Подключает массивы из снимка без копирования: слова слота slot — [offsets[slot], offsets[slot + 1])
+    void AttachMapped(const uint64_t* offsets, const uint32_t* term_ids, const double* term_freqs, size_t slot_count);
+
+private:
+    // Перезапись не запускается, пока мусора меньше этого числа слов
+    static const size_t MIN_GARBAGE_TO_COMPACT = 4096;
+
+    struct Range {
+        uint64_t offset = 0;
+        uint32_t size = 0;
+        // Слова лежат в массивах снимка
+        bool is_mapped = false;
+    };
+
+    std::vector<Range> ranges_;
+    std::vector<uint32_t> term_ids_;
+    std::vector<double> term_freqs_;
+    size_t garbage_size_ = 0;
+    const uint32_t* mapped_term_ids_ = nullptr;
+    const double* mapped_term_freqs_ = nullptr;
+
+    // Освобождает прежние слова слота и возвращает его диапазон
+    Range& ReleaseSlot(uint32_t slot);
+    void CompactIfNeeded();
+};
+
+template <typename TermFreqs>
+void ForwardIndex::Set(uint32_t slot, const TermFreqs& term_freqs) {
+    Range& range = ReleaseSlot(slot);
+    range.offset = term_ids_.size();
+    range.size = static_cast<uint32_t>(term_freqs.size());
+    range.is_mapped = false;
+    for (const auto& term_freq : term_freqs) {
+        term_ids_.push_back(term_freq.term_id);
+        term_freqs_.push_back(term_freq.freq);
+    }
+    CompactIfNeeded();
+}
+
+// Слова документа и их частоты в порядке id слов, без копирования.
+// Действительно, пока индекс не изменён
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const WordFrequencies* words, size_t index)
+                : words_(words)
+                , index_(index) {
+        }
+
+        value_type operator*() const {
+            return {words_->terms_->GetTerm(words_->entries_.term_ids[index_]), words_->entries_.term_freqs[index_]};
+        }
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const WordFrequencies* words_;
+        size_t index_;
+    };
+
+    WordFrequencies() = default;
+    WordFrequencies(const TermDictionary* terms, ForwardIndex::Entries entries)
+            : terms_(terms)
+            , entries_(entries) {
+    }
+
+    Iterator begin() const {
+        return {this, 0};
+    }
+    Iterator end() const {
+        return {this, entries_.size};
+    }
+    size_t size() const {
+        return entries_.size;
+    }
+    bool empty() const {
+        return entries_.size == 0;
+    }
+
+private:
+    const TermDictionary* terms_ = nullptr;
+    ForwardIndex::Entries entries_;
+};
@@ -0,0 +1,56 @@
+#include "impact_postings.h"
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+ImpactPostings::ImpactPostings(const PostingList& postings, const TermScoring& unit_scoring, const vector<uint32_t>& document_lengths) {
+    vector<uint32_t> slots;
+    vector<double> term_freqs;
+    slots.reserve(postings.size());
+    term_freqs.reserve(postings.size());
+    postings.ForEachBlock(document_lengths.data(), [&](const uint32_t* block_slots, const double* block_term_freqs, size_t count) {
+        slots.insert(slots.end(), block_slots, block_slots + count);
+        term_freqs.insert(term_freqs.end(), block_term_freqs, block_term_freqs + count);
+    });
+    vector<double> impacts(slots.size());
+    for (size_t i = 0; i < slots.size(); ++i) {
+        impacts[i] = ScorePosting(unit_scoring, term_freqs[i], document_lengths.data(), slots[i]);
+    }
+    vector<uint32_t> order(slots.size());
+    iota(order.begin(), order.end(), 0);
+    // Равные вклады остаются в порядке слотов
+    stable_sort(order.begin(), order.end(), [&impacts](uint32_t lhs, uint32_t rhs) {
+        return impacts[lhs] > impacts[rhs];
+    });
+    slots_.reserve(order.size());
+    term_freqs_.reserve(order.size());
+    for (const uint32_t index : order) {
+        slots_.push_back(slots[index]);
+        term_freqs_.push_back(term_freqs[index]);
+    }
+
+    size_t tier_level = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const double impact = impacts[order[i]];
+        const double share = impact / impacts[order.front()];
+        const size_t level = min(MAX_TIER_COUNT - 1, static_cast<size_t>((1.0 - share) * MAX_TIER_COUNT));
+        if (tiers_.empty() || level != tier_level) {
+            tiers_.push_back({i, i, impact});
+            tier_level = level;
+        }
+        tiers_.back().end = i + 1;
+    }
+}
+
+const vector<ImpactPostings::Tier>& ImpactPostings::GetTiers() const {
+    return tiers_;
+}
+
+const uint32_t* ImpactPostings::GetSlots() const {
+    return slots_.data();
+}
+
+const double* ImpactPostings::GetTermFreqs() const {
+    return term_freqs_.data();
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "posting_list.h"
+#include "scoring_kernel.h"
+
+// Копия списка вхождений слова, упорядоченная по убыванию вклада вхождения в релевантность
+// при IDF = 1: вклад при любом IDF получается умножением на него. Список разбит на уровни
+// равной ширины по доле от наибольшего вклада max: при n = MAX_TIER_COUNT уровень t содержит
+// вклады из (max * (1 - (t + 1) / n), max * (1 - t / n)], последний — все не больше max / n.
+// Пустые уровни не хранятся. Наибольший вклад уровня ограничивает вклады всех его вхождений
+class ImpactPostings {
+public:
+    static const size_t MAX_TIER_COUNT = 16;
+
+    struct Tier {
+        size_t begin;
+        size_t end;
+        double max_impact;
+    };
+
+    ImpactPostings() = default;
+    // unit_scoring — оценка слова с IDF = 1; document_lengths индексируется слотом
+    ImpactPostings(const PostingList& postings, const TermScoring& unit_scoring, const std::vector<uint32_t>& document_lengths);
+
+    const std::vector<Tier>& GetTiers() const;
+    const uint32_t* GetSlots() const;
+    const double* GetTermFreqs() const;
+
+private:
+    std::vector<uint32_t> slots_;
+    std::vector<double> term_freqs_;
+    std::vector<Tier> tiers_;
+};
@@ -1,11 +1,21 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <random>
+#include <set>
+#include <thread>
+#include "async_search_server.h"
 #include "search_server.h"
 #include "request_queue.h"
 #include "paginator.h"
-//#include "remove_duplicates.h"
+#include "remove_duplicates.h"
 #include "log_duration.h"
 #include "process_queries.h"
+#include "segmented_search_server.h"
 
 using namespace std;
 string GenerateWord(mt19937& generator, int max_length) {
@@ -59,15 +69,866 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
     cout << total_relevance << endl;
 }
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+// Одни и те же документы в том же порядке, релевантность — с точностью до погрешности суммирования
+bool AreSameResults(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id && abs(lhs.relevance - rhs.relevance) < 1e-6;
+    });
+}
+// Выдача после удаления документов — до уплотнения и после — совпадает с индексом, построенным без них
+void TestCompaction(mt19937& generator, const vector<string>& dictionary) {
+    const auto documents = GenerateQueries(generator, dictionary, 3'000, 30);
+    const auto queries = GenerateQueries(generator, dictionary, 200, 5);
+    SearchServer search_server(dictionary[0]);
+    SearchServer expected_server(dictionary[0]);
+    // Повторное уплотнение только явное, чтобы проверить выдачу и с удалёнными документами в списках
+    search_server.SetCompactionThreshold(1.0);
+    vector<int> removed_ids;
+    for (int id = 0; id < static_cast<int>(documents.size()); ++id) {
+        // Рейтинг равен id, чтобы порядок документов с равной релевантностью не зависел от слотов
+        search_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {id});
+        if (uniform_int_distribution(0, 2)(generator) == 0) {
+            removed_ids.push_back(id);
+        } else {
+            expected_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {id});
+        }
+    }
+    // Уплотнение распаковывает сжатые списки
+    search_server.CompressIndex();
+    search_server.RemoveDocuments(removed_ids);
+
+    int mismatch_count = 0;
+    const auto check = [&] {
+        for (const string& query : queries) {
+            const string minus_query = query + " -"s + dictionary[uniform_int_distribution<size_t>(1, dictionary.size() - 1)(generator)];
+            for (const string& text : {query, minus_query}) {
+                if (!AreSameResults(search_server.FindTopDocuments(text), expected_server.FindTopDocuments(text))
+                    || !AreSameResults(search_server.FindTopDocuments(execution::par, text), expected_server.FindTopDocuments(text))) {
+                    ++mismatch_count;
+                }
+            }
+        }
+        if (search_server.GetDocumentCount() != expected_server.GetDocumentCount()) {
+            ++mismatch_count;
+        }
+    };
+    check();
+    search_server.Compact();
+    if (search_server.GetDeletedDocumentCount() != 0) {
+        ++mismatch_count;
+    }
+    check();
+    cout << "compaction mismatches: "s << mismatch_count << endl;
+}
+// Поиск по уровням вклада после BuildImpactIndex совпадает с обычным поиском лучших документов
+void TestImpactIndex(mt19937& generator, const vector<string>& dictionary) {
+    // Частые слова встречаются в тысячах документов, так что для них строятся списки по вкладу
+    const auto skewed_word = [&generator, &dictionary] {
+        const size_t frequent_count = 300;
+        return dictionary[min(uniform_int_distribution<size_t>(1, frequent_count)(generator),
+                              uniform_int_distribution<size_t>(1, dictionary.size() - 1)(generator))];
+    };
+    SearchServer search_server(dictionary[0]);
+    SearchServer impact_server(dictionary[0]);
+    for (int id = 0; id < 20'000; ++id) {
+        string text;
+        for (int i = uniform_int_distribution(1, 40)(generator); i > 0; --i) {
+            text += skewed_word() + ' ';
+        }
+        // Рейтинг равен id, чтобы порядок документов с равной релевантностью был однозначным
+        const DocumentStatus status = id % 7 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+        search_server.AddDocument(id, text, status, {id});
+        impact_server.AddDocument(id, text, status, {id});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 200; ++i) {
+        string query;
+        for (int j = uniform_int_distribution(1, 6)(generator); j > 0; --j) {
+            query += skewed_word() + ' ';
+        }
+        if (i % 3 == 0) {
+            query += '-' + skewed_word();
+        }
+        queries.push_back(query);
+    }
+
+    int mismatch_count = 0;
+    for (const RankingModel model : {RankingModel::TF_IDF, RankingModel::BM25}) {
+        search_server.SetRankingModel(model);
+        impact_server.SetRankingModel(model);
+        impact_server.BuildImpactIndex();
+        for (const string& query : queries) {
+            for (const size_t top_count : {size_t{1}, size_t{5}, size_t{50}}) {
+                const auto is_even = [](int document_id, DocumentStatus, int) {
+                    return document_id % 2 == 0;
+                };
+                if (!AreSameResults(impact_server.FindTopDocuments(query, StatusIs{DocumentStatus::ACTUAL}, top_count),
+                                    search_server.FindTopDocuments(query, StatusIs{DocumentStatus::ACTUAL}, top_count))
+                    || !AreSameResults(impact_server.FindTopDocuments(query, is_even, top_count),
+                                       search_server.FindTopDocuments(query, is_even, top_count))) {
+                    ++mismatch_count;
+                }
+            }
+        }
+    }
+    cout << "impact index mismatches: "s << mismatch_count << endl;
+}
+// Запросы с обязательными словами совпадают с обычным поиском среди документов, содержащих все обязательные слова.
+// Обязательное слово, которого нет в индексе, даёт пустую выдачу
+void TestConjunctiveQuery(mt19937& generator, const vector<string>& dictionary) {
+    const auto documents = GenerateQueries(generator, dictionary, 5'000, 40);
+    SearchServer search_server(dictionary[0]);
+    map<string, set<int>, less<>> word_to_documents;
+    for (int id = 0; id < static_cast<int>(documents.size()); ++id) {
+        // Рейтинг равен id, чтобы порядок документов с равной релевантностью был однозначным
+        search_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {id});
+        for (const auto& [word, term_freq] : search_server.GetWordFrequencies(id)) {
+            word_to_documents[string(word)].insert(id);
+        }
+    }
+    const auto random_word = [&generator, &dictionary] {
+        return dictionary[uniform_int_distribution<size_t>(1, dictionary.size() - 1)(generator)];
+    };
+
+    int mismatch_count = 0;
+    for (int i = 0; i < 300; ++i) {
+        vector<string> required_words;
+        string query;
+        string plain_query;
+        for (int j = uniform_int_distribution(1, 2)(generator); j > 0; --j) {
+            required_words.push_back(random_word());
+            query += '+' + required_words.back() + ' ';
+            plain_query += required_words.back() + ' ';
+        }
+        for (int j = uniform_int_distribution(0, 3)(generator); j > 0; --j) {
+            const string word = random_word();
+            query += word + ' ';
+            plain_query += word + ' ';
+        }
+        if (i % 2 == 0) {
+            const string minus_word = '-' + random_word();
+            query += minus_word;
+            plain_query += minus_word;
+        }
+        const auto has_required_words = [&](int document_id, DocumentStatus, int) {
+            return all_of(required_words.begin(), required_words.end(), [&](const string& word) {
+                const auto it = word_to_documents.find(word);
+                return it != word_to_documents.end() && it->second.count(document_id) > 0;
+            });
+        };
+        for (const size_t top_count : {size_t{5}, documents.size()}) {
+            const auto expected = search_server.FindTopDocuments(plain_query, has_required_words, top_count);
+            if (!AreSameResults(search_server.FindTopDocuments(query, StatusIs{DocumentStatus::ACTUAL}, top_count), expected)
+                || !AreSameResults(search_server.FindTopDocuments(execution::par, query, StatusIs{DocumentStatus::ACTUAL}, top_count), expected)) {
+                ++mismatch_count;
+            }
+        }
+        // Слова длиннее слов словаря в индексе нет
+        const string missing_query = query + " +"s + string(20, 'q');
+        if (!search_server.FindTopDocuments(missing_query).empty() || !search_server.FindTopDocuments(execution::par, missing_query).empty()) {
+            ++mismatch_count;
+        }
+    }
+    cout << "conjunctive query mismatches: "s << mismatch_count << endl;
+}
+// Скорость полного прохода по вхождениям: словарь против плоского и сжатого списков
+void TestPostingsScan(mt19937& generator, int posting_count, int repeat_count) {
+    map<int, double> postings_map;
+    PostingList postings;
+    PostingList compressed_postings;
+    vector<uint32_t> word_counts;
+    for (int id = 0; static_cast<int>(postings_map.size()) < posting_count; id += uniform_int_distribution(1, 8)(generator)) {
+        const uint32_t word_count = uniform_int_distribution(1, 70)(generator);
+        const double term_freq = uniform_int_distribution<uint32_t>(1, word_count)(generator) * (1.0 / word_count);
+        word_counts.resize(id + 1);
+        word_counts[id] = word_count;
+        postings_map[id] = term_freq;
+        postings.Add(id, term_freq);
+        compressed_postings.Add(id, term_freq);
+    }
+    compressed_postings.Compress(word_counts.data());
+    {
+        LOG_DURATION("scan map"s);
+        double total = 0;
+        for (int i = 0; i < repeat_count; ++i) {
+            for (const auto& [id, term_freq] : postings_map) {
+                total += term_freq;
+            }
+        }
+        cout << total << endl;
+    }
+    const auto scan = [repeat_count, &word_counts](const PostingList& postings) {
+        double total = 0;
+        for (int i = 0; i < repeat_count; ++i) {
+            postings.ForEachBlock(word_counts.data(), [&total](const uint32_t*, const double* term_freqs, size_t count) {
+                for (size_t j = 0; j < count; ++j) {
+                    total += term_freqs[j];
+                }
+            });
+        }
+        cout << total << endl;
+    };
+    {
+        LOG_DURATION("scan posting list"s);
+        scan(postings);
+    }
+    {
+        LOG_DURATION("scan compressed posting list"s);
+        scan(compressed_postings);
+    }
+}
+// Упаковка блоков всех ширин и сжатый список против исходного: распаковка, обход и курсор
+void TestBitPacking(mt19937& generator) {
+    int mismatch_count = 0;
+    const size_t block_size = BIT_PACKING_BLOCK_SIZE;
+    for (int bits = 0; bits <= 32; ++bits) {
+        vector<uint32_t> values(block_size);
+        for (uint32_t& value : values) {
+            value = bits == 0 ? 0 : static_cast<uint32_t>(generator() >> (32 - bits));
+        }
+        if (bits > 0) {
+            values[0] = static_cast<uint32_t>(~0ull >> (64 - bits));
+        }
+        if (RequiredBitWidth(values.data(), block_size) != bits) {
+            ++mismatch_count;
+        }
+        vector<uint32_t> packed(4 * bits + 1, 0xdeadbeef);
+        if (PackBlock(values.data(), bits, packed.data()) != 4 * static_cast<size_t>(bits) || packed.back() != 0xdeadbeef) {
+            ++mismatch_count;
+        }
+        vector<uint32_t> unpacked(block_size);
+        UnpackBlock(packed.data(), bits, unpacked.data());
+        if (unpacked != values) {
+            ++mismatch_count;
+        }
+    }
+
+    // Последний блок неполный, шаги между слотами разной ширины
+    PostingList postings;
+    vector<uint32_t> word_counts;
+    for (uint32_t slot = 0, i = 0; i < 1000; ++i, slot += uniform_int_distribution<uint32_t>(1, i % 3 == 0 ? 100'000 : 4)(generator)) {
+        const uint32_t word_count = uniform_int_distribution<uint32_t>(1, 1000)(generator);
+        word_counts.resize(slot + 1);
+        word_counts[slot] = word_count;
+        postings.Add(slot, CompressedPostingList::ComputeTermFreq(uniform_int_distribution<uint32_t>(1, word_count)(generator), word_count));
+    }
+    PostingList compressed_postings = postings;
+    compressed_postings.Compress(word_counts.data());
+    if (!compressed_postings.IsCompressed() || compressed_postings.size() != postings.size()) {
+        ++mismatch_count;
+    }
+    vector<pair<uint32_t, double>> expected;
+    vector<pair<uint32_t, double>> decoded;
+    postings.ForEachBlock(word_counts.data(), [&expected](const uint32_t* slots, const double* term_freqs, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            expected.push_back({slots[i], term_freqs[i]});
+        }
+    });
+    compressed_postings.ForEachBlock(word_counts.data(), [&decoded](const uint32_t* slots, const double* term_freqs, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            decoded.push_back({slots[i], term_freqs[i]});
+        }
+    });
+    if (decoded != expected) {
+        ++mismatch_count;
+    }
+    DecodedPostingBlock buffer;
+    for (PostingCursor cursor(compressed_postings, word_counts.data(), &buffer); !cursor.IsEnd(); cursor.Next()) {
+        decoded.push_back({cursor.GetSlot(), cursor.GetTermFreq()});
+    }
+    if (!equal(expected.begin(), expected.end(), decoded.begin() + expected.size(), decoded.end())) {
+        ++mismatch_count;
+    }
+    compressed_postings.Decompress(word_counts.data());
+    decoded.clear();
+    compressed_postings.ForEachBlock(word_counts.data(), [&decoded](const uint32_t* slots, const double* term_freqs, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            decoded.push_back({slots[i], term_freqs[i]});
+        }
+    });
+    if (compressed_postings.IsCompressed() || decoded != expected) {
+        ++mismatch_count;
+    }
+    cout << "bit packing mismatches: "s << mismatch_count << endl;
+}
+// Совпадение оценок вхождений всех реализаций ScorePostings с ScorePosting до бита, для TF-IDF и BM25
+void TestScoringKernels(mt19937& generator) {
+    vector<uint32_t> document_lengths(100'000);
+    for (uint32_t& length : document_lengths) {
+        length = uniform_int_distribution<uint32_t>(1, 10'000)(generator);
+    }
+    int mismatch_count = 0;
+    for (int i = 0; i < 2'000; ++i) {
+        const double inverse_document_freq = uniform_real_distribution(0.0, 12.0)(generator);
+        const Bm25Parameters parameters{uniform_real_distribution(0.0, 3.0)(generator), uniform_real_distribution(0.0, 1.0)(generator)};
+        const TermScoring scoring = i % 2 == 0 ? MakeTfIdfScoring(inverse_document_freq)
+                                               : MakeBm25Scoring(inverse_document_freq, parameters, uniform_real_distribution(1.0, 1000.0)(generator));
+        // Длины пачек не кратны ширине векторов, чтобы проверить и досчёт хвостов
+        const size_t count = uniform_int_distribution<size_t>(0, 300)(generator);
+        vector<uint32_t> slots(count);
+        vector<double> term_freqs(count);
+        for (size_t j = 0; j < count; ++j) {
+            slots[j] = uniform_int_distribution<uint32_t>(0, document_lengths.size() - 1)(generator);
+            const uint32_t length = document_lengths[slots[j]];
+            term_freqs[j] = uniform_int_distribution<uint32_t>(1, length)(generator) * (1.0 / length);
+        }
+        for (const ScoringKernel kernel : {ScoringKernel::SCALAR, ScoringKernel::AVX2, ScoringKernel::AVX512}) {
+            vector<double> scores(count);
+            ScorePostings(kernel, scoring, slots.data(), term_freqs.data(), count, document_lengths.data(), scores.data());
+            for (size_t j = 0; j < count; ++j) {
+                if (scores[j] != ScorePosting(scoring, term_freqs[j], document_lengths.data(), slots[j])) {
+                    ++mismatch_count;
+                }
+            }
+        }
+    }
+    cout << "scoring kernel mismatches: "s << mismatch_count << endl;
+}
+// Совпадение реализаций разбора текста с SplitIntoWords и посимвольной проверкой, затем их скорость
+void TestTextScanner(mt19937& generator, const vector<string>& dictionary) {
+    const char alphabet[] = {'a', 'z', ' ', ' ', '\t', '\0', '\x1f', '\x7f', '\x80', '\xff'};
+    int mismatch_count = 0;
+    for (int i = 0; i < 20'000; ++i) {
+        string text(uniform_int_distribution(0, 200)(generator), ' ');
+        for (char& c : text) {
+            // Управляющие символы редки, чтобы большинство текстов было допустимо
+            c = alphabet[uniform_int_distribution(0, i % 2 == 0 ? 3 : 9)(generator)];
+        }
+        const bool is_valid = none_of(text.begin(), text.end(), [](char c) {
+            return c >= '\0' && c < ' ';
+        });
+        const vector<string_view> expected = SplitIntoWords(text);
+        for (const TextScanKernel kernel : {TextScanKernel::SCALAR, TextScanKernel::SSE2, TextScanKernel::AVX2}) {
+            vector<string_view> words;
+            if (TokenizeText(kernel, text, words) != is_valid || (is_valid && words != expected)) {
+                ++mismatch_count;
+            }
+        }
+    }
+    cout << "text scanner mismatches: "s << mismatch_count << endl;
+
+    string text;
+    while (text.size() < 64 * 1024 * 1024) {
+        text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)];
+        text += ' ';
+    }
+    const auto measure = [&text](string_view mark, auto tokenize) {
+        vector<string_view> words;
+        const int repeat_count = 5;
+        const auto start = chrono::steady_clock::now();
+        for (int i = 0; i < repeat_count; ++i) {
+            words.clear();
+            tokenize(words);
+        }
+        const chrono::duration<double> duration = chrono::steady_clock::now() - start;
+        cout << mark << ": "s << text.size() * repeat_count / duration.count() / 1e9 << " GB/s, "s << words.size() << " words"s << endl;
+    };
+    measure("SplitIntoWords + none_of"sv, [&text](vector<string_view>& words) {
+        if (none_of(text.begin(), text.end(), [](char c) { return c >= '\0' && c < ' '; })) {
+            words = SplitIntoWords(text);
+        }
+    });
+    const pair<TextScanKernel, string_view> kernels[] = {
+        {TextScanKernel::SCALAR, "scalar scanner"sv},
+        {TextScanKernel::SSE2, "SSE2 scanner"sv},
+        {TextScanKernel::AVX2, "AVX2 scanner"sv},
+    };
+    for (const auto& [kernel, mark] : kernels) {
+        if (IsTextScanKernelSupported(kernel)) {
+            measure(mark, [&text, kernel = kernel](vector<string_view>& words) {
+                TokenizeText(kernel, text, words);
+            });
+        }
+    }
+}
+// Индекс, восстановленный из журнала — целого, с оборванным или испорченным хвостом, поверх снимка, —
+// совпадает с индексом, в котором выполнены только уцелевшие изменения
+void TestWriteAheadLog(mt19937& generator, const vector<string>& dictionary) {
+    struct Change {
+        bool is_add;
+        int document_id;
+        string document;
+    };
+    const string log_path = "search_server.wal"s;
+    const string snapshot_path = "search_server_wal.snapshot"s;
+    remove(log_path.c_str());
+    const auto queries = GenerateQueries(generator, dictionary, 100, 5);
+
+    // Запись журнала с номером i + 1 — изменение changes[i]. Снимок сохраняется после snapshot_change_count изменений
+    vector<Change> changes;
+    const size_t snapshot_change_count = 200;
+    {
+        SearchServer search_server(dictionary[0]);
+        search_server.OpenWriteAheadLog(log_path);
+        vector<int> ids;
+        for (int id = 0; changes.size() < 400; ++id) {
+            if (!ids.empty() && uniform_int_distribution(0, 3)(generator) == 0) {
+                const size_t index = uniform_int_distribution<size_t>(0, ids.size() - 1)(generator);
+                changes.push_back({false, ids[index], {}});
+                search_server.RemoveDocument(ids[index]);
+                ids.erase(ids.begin() + index);
+            } else {
+                changes.push_back({true, id, GenerateQuery(generator, dictionary, 20)});
+                search_server.AddDocument(id, changes.back().document, DocumentStatus::ACTUAL, {id});
+                ids.push_back(id);
+            }
+            if (changes.size() == snapshot_change_count) {
+                search_server.Save(snapshot_path);
+            }
+        }
+    }
+    const auto build_expected = [&](size_t change_count) {
+        SearchServer search_server(dictionary[0]);
+        for (size_t i = 0; i < change_count; ++i) {
+            if (changes[i].is_add) {
+                search_server.AddDocument(changes[i].document_id, changes[i].document, DocumentStatus::ACTUAL, {changes[i].document_id});
+            } else {
+                search_server.RemoveDocument(changes[i].document_id);
+            }
+        }
+        return search_server;
+    };
+
+    const auto read_file = [](const string& path) {
+        ifstream input(path, ios::binary);
+        return string(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    };
+    const auto write_file = [](const string& path, const string& data) {
+        ofstream(path, ios::binary | ios::trunc) << data;
+    };
+    const string log_data = read_file(log_path);
+    // Границы записей: в заголовке записи длина данных, контрольная сумма, номер и тип
+    const size_t header_size = 4 + 4 + 8 + 1;
+    vector<size_t> record_begins;
+    for (size_t pos = 0; pos < log_data.size();) {
+        record_begins.push_back(pos);
+        uint32_t payload_size;
+        memcpy(&payload_size, log_data.data() + pos, sizeof(payload_size));
+        pos += header_size + payload_size;
+    }
+    record_begins.push_back(log_data.size());
+
+    int mismatch_count = 0;
+    if (record_begins.size() != changes.size() + 1) {
+        ++mismatch_count;
+    }
+    const auto check = [&](const SearchServer& search_server, size_t change_count) {
+        const SearchServer expected_server = build_expected(change_count);
+        for (const string& query : queries) {
+            if (!AreSameResults(search_server.FindTopDocuments(query), expected_server.FindTopDocuments(query))) {
+                ++mismatch_count;
+            }
+        }
+        if (search_server.GetDocumentCount() != expected_server.GetDocumentCount()) {
+            ++mismatch_count;
+        }
+    };
+    // Записывает в журнал data, восстанавливает из него индекс и сравнивает с первыми change_count изменениями
+    const auto check_recovery = [&](const string& data, size_t change_count) {
+        write_file(log_path, data);
+        SearchServer search_server(dictionary[0]);
+        search_server.OpenWriteAheadLog(execution::par, log_path);
+        check(search_server, change_count);
+    };
+
+    // Весь журнал
+    check_recovery(log_data, changes.size());
+    // Хвост оборван посреди записи
+    const size_t torn_index = 300;
+    check_recovery(log_data.substr(0, record_begins[torn_index] + header_size + 3), torn_index);
+    // Данные записи не совпадают с контрольной суммой, следующие записи отбрасываются
+    string corrupted_data = log_data;
+    corrupted_data[record_begins[torn_index] + header_size] ^= 1;
+    check_recovery(corrupted_data, torn_index);
+    // Остаток старой записи с меньшим номером обрывает журнал, даже если за ним целые записи
+    const string stale_data = log_data.substr(0, record_begins[torn_index])
+        + log_data.substr(record_begins[0], record_begins[1] - record_begins[0])
+        + log_data.substr(record_begins[torn_index]);
+    check_recovery(stale_data, torn_index);
+
+    // Новая запись после оборванного хвоста дописывается к уцелевшему началу журнала
+    write_file(log_path, log_data.substr(0, record_begins[torn_index] + 5));
+    {
+        SearchServer search_server(dictionary[0]);
+        search_server.OpenWriteAheadLog(log_path);
+        search_server.AddDocument(changes[torn_index].document_id + 10'000, "appended after torn tail"s, DocumentStatus::ACTUAL, {0});
+    }
+    {
+        SearchServer search_server(dictionary[0]);
+        search_server.OpenWriteAheadLog(log_path);
+        if (search_server.GetDocumentCount() != build_expected(torn_index).GetDocumentCount() + 1
+            || search_server.FindTopDocuments("appended"s).size() != 1) {
+            ++mismatch_count;
+        }
+    }
+
+    // Поверх снимка применяются только записи с номерами больше сохранённого в нём
+    write_file(log_path, log_data);
+    {
+        SearchServer search_server = SearchServer::Load(snapshot_path);
+        check(search_server, snapshot_change_count);
+        search_server.OpenWriteAheadLog(log_path);
+        check(search_server, changes.size());
+    }
+    remove(log_path.c_str());
+    remove(snapshot_path.c_str());
+    cout << "write-ahead log mismatches: "s << mismatch_count << endl;
+}
+// Выдача сегментированного индекса после Refresh совпадает с одним SearchServer с теми же документами:
+// после многоуровневых слияний и после удалений, пришедших во время идущего слияния
+void TestSegmentedIndex(mt19937& generator, const vector<string>& dictionary) {
+    const auto queries = GenerateQueries(generator, dictionary, 200, 5);
+    SegmentedSearchServer segmented_server(dictionary[0], 100);
+    SearchServer expected_server(dictionary[0]);
+    vector<int> ids;
+    int next_id = 0;
+    const auto add_documents = [&](int document_count) {
+        for (int i = 0; i < document_count; ++i, ++next_id) {
+            const string document = GenerateQuery(generator, dictionary, 20);
+            segmented_server.AddDocument(next_id, document, DocumentStatus::ACTUAL, {next_id});
+            expected_server.AddDocument(next_id, document, DocumentStatus::ACTUAL, {next_id});
+            ids.push_back(next_id);
+        }
+    };
+    const auto remove_document = [&] {
+        const size_t index = uniform_int_distribution<size_t>(0, ids.size() - 1)(generator);
+        segmented_server.RemoveDocument(ids[index]);
+        expected_server.RemoveDocument(ids[index]);
+        ids.erase(ids.begin() + index);
+    };
+
+    int mismatch_count = 0;
+    const auto check = [&] {
+        segmented_server.Refresh();
+        const auto reader = segmented_server.GetReader();
+        for (const string& query : queries) {
+            if (!AreSameResults(reader.FindTopDocuments(query), expected_server.FindTopDocuments(query))) {
+                ++mismatch_count;
+            }
+        }
+        if (reader.GetDocumentCount() != expected_server.GetDocumentCount()) {
+            ++mismatch_count;
+        }
+    };
+
+    // 64 заполненных сегмента сливаются в сегменты нескольких уровней
+    for (int round = 0; round < 64; ++round) {
+        add_documents(100);
+        for (int i = 0; i < 10; ++i) {
+            remove_document();
+        }
+    }
+    check();
+    segmented_server.WaitForMerges();
+    if (segmented_server.GetSegmentCount() >= 16) {
+        ++mismatch_count;
+    }
+    check();
+
+    // Удаления сразу после заморозки сегмента, запустившей слияние, частью приходятся на время слияния
+    for (int round = 0; round < 16; ++round) {
+        add_documents(100);
+        for (int i = 0; i < 50; ++i) {
+            remove_document();
+            this_thread::sleep_for(100us);
+        }
+        check();
+    }
+    segmented_server.WaitForMerges();
+    check();
+    cout << "segmented index mismatches: "s << mismatch_count << endl;
+}
+// Читатели ищут, пока писатель добавляет и удаляет документы, а фоновый поток сливает сегменты.
+// Закреплённая читателем версия не освобождается: слова из MatchDocument остаются словами словаря.
+// С публикацией после каждой записи изменение видно поиску сразу по возвращении из неё
+void TestSegmentedConcurrency(mt19937& generator, const vector<string>& dictionary) {
+    const auto queries = GenerateQueries(generator, dictionary, 100, 3);
+    const set<string, less<>> words(dictionary.begin(), dictionary.end());
+    SegmentedSearchServer segmented_server(dictionary[0], SegmentedSearchServer::DEFAULT_SEGMENT_SIZE,
+                                           SegmentedSearchServer::RefreshPolicy::AFTER_EACH_WRITE);
+    SearchServer expected_server(dictionary[0]);
+
+    atomic<bool> is_writing = true;
+    atomic<int> mismatch_count = 0;
+    vector<thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&, i] {
+            for (size_t query_index = i; is_writing; query_index = (query_index + 1) % queries.size()) {
+                const auto reader = segmented_server.GetReader();
+                const string& query = queries[query_index];
+                for (const Document& document : reader.FindTopDocuments(query)) {
+                    const auto [matched_words, status] = reader.MatchDocument(query, document.id);
+                    if (matched_words.empty() || any_of(matched_words.begin(), matched_words.end(), [&words](string_view word) {
+                            return words.count(word) == 0;
+                        })) {
+                        ++mismatch_count;
+                    }
+                }
+            }
+        });
+    }
+
+    vector<int> ids;
+    for (int id = 0; id < 3'000; ++id) {
+        if (!ids.empty() && uniform_int_distribution(0, 3)(generator) == 0) {
+            const size_t index = uniform_int_distribution<size_t>(0, ids.size() - 1)(generator);
+            segmented_server.RemoveDocument(ids[index]);
+            expected_server.RemoveDocument(ids[index]);
+            ids.erase(ids.begin() + index);
+        } else {
+            const string document = GenerateQuery(generator, dictionary, 20);
+            segmented_server.AddDocument(id, document, DocumentStatus::ACTUAL, {id});
+            expected_server.AddDocument(id, document, DocumentStatus::ACTUAL, {id});
+            ids.push_back(id);
+            try {
+                segmented_server.GetReader().MatchDocument(document, id);
+            } catch (const out_of_range&) {
+                ++mismatch_count;
+            }
+        }
+        if (segmented_server.GetReader().GetDocumentCount() != static_cast<int>(ids.size())) {
+            ++mismatch_count;
+        }
+    }
+    is_writing = false;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+
+    segmented_server.WaitForMerges();
+    for (const string& query : queries) {
+        if (!AreSameResults(segmented_server.FindTopDocuments(query), expected_server.FindTopDocuments(query))) {
+            ++mismatch_count;
+        }
+    }
+    cout << "segmented concurrency mismatches: "s << mismatch_count << endl;
+}
+// Асинхронный поиск: выдача с заданным числом документов, отклонение сверх глубины очереди,
+// истёкший срок до и во время ожидания в очереди и отмена, прерывающая обход списка вхождений
+void TestAsyncSearch(mt19937& generator, const vector<string>& dictionary) {
+    // Слово common есть в каждом документе, так что его список вхождений проходится долго
+    SearchServer search_server(dictionary[0]);
+    for (int id = 0; id < 20'000; ++id) {
+        search_server.AddDocument(id, "common "s + GenerateQuery(generator, dictionary, 10), DocumentStatus::ACTUAL, {id});
+    }
+    const string query = GenerateQuery(generator, dictionary, 3);
+    int mismatch_count = 0;
+    const auto is_cancelled = [](future<vector<Document>>& documents) {
+        try {
+            documents.get();
+        } catch (const QueryCancelledError&) {
+            return true;
+        }
+        return false;
+    };
+
+    // Единственный поток пула занят, пока не выполнен promise: очередь заполняется предсказуемо
+    AsyncSearchServer async_server(search_server, 2, 1);
+    promise<void> release_pool;
+    const bool is_blocking_admitted = async_server.FindTopDocuments("common"s, DocumentStatus::ACTUAL, nullptr,
+                                                                    [pool_released = release_pool.get_future().share()](exception_ptr, vector<Document>) {
+                                                                        pool_released.wait();
+                                                                    });
+    while (async_server.GetMetrics().queue_depth != 0) {
+        this_thread::yield();
+    }
+    auto top_documents = async_server.FindTopDocuments(query, DocumentStatus::ACTUAL, nullptr, 3);
+    // Срок истекает, пока запрос ждёт в очереди
+    auto expired_in_queue = async_server.FindTopDocuments(query, DocumentStatus::ACTUAL,
+                                                          make_shared<CancellationToken>(CancellationToken::Clock::now() + 20ms));
+    bool is_rejected = false;
+    try {
+        async_server.FindTopDocuments(query);
+    } catch (const QueryRejectedError&) {
+        is_rejected = true;
+    }
+    if (!is_blocking_admitted || !is_rejected
+        || async_server.FindTopDocuments(query, DocumentStatus::ACTUAL, nullptr, [](exception_ptr, vector<Document>) {})) {
+        ++mismatch_count;
+    }
+    this_thread::sleep_for(30ms);
+    release_pool.set_value();
+    if (!AreSameResults(top_documents.get(), search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 3)) || !is_cancelled(expired_in_queue)) {
+        ++mismatch_count;
+    }
+
+    // Срок истёк ещё до приёма запроса
+    auto expired = async_server.FindTopDocuments(query, DocumentStatus::ACTUAL, make_shared<CancellationToken>(CancellationToken::Clock::now()));
+    if (!is_cancelled(expired)) {
+        ++mismatch_count;
+    }
+    const AsyncQueryMetrics metrics = async_server.GetMetrics();
+    if (metrics.admitted_count != 4 || metrics.rejected_count != 2 || metrics.cancelled_count != 2 || metrics.queue_depth != 0) {
+        ++mismatch_count;
+    }
+
+    // Отмена посреди обхода: предикат отменяет запрос на первом документе, и поиск прерывается,
+    // не дойдя до конца списка вхождений — как при полном подсчёте, так и при поиске с отсечением
+    for (const size_t top_count : {static_cast<size_t>(search_server.GetDocumentCount()) + 1, static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)}) {
+        CancellationToken cancellation;
+        int checked_count = 0;
+        try {
+            search_server.FindTopDocuments("common"s, [&](int, DocumentStatus, int) {
+                cancellation.Cancel();
+                ++checked_count;
+                return true;
+            }, top_count, cancellation);
+            ++mismatch_count;
+        } catch (const QueryCancelledError&) {
+            if (checked_count >= search_server.GetDocumentCount() / 2) {
+                ++mismatch_count;
+            }
+        }
+    }
+    cout << "async search mismatches: "s << mismatch_count << endl;
+}
+// Поиск дубликатов и почти дубликатов и проверка дубликатов при добавлении — по одному документу
+// и пакетом, где дубликат может повторять документ того же пакета
+void TestDuplicates(mt19937& generator, const vector<string>& dictionary) {
+    // Дубликат — перемешанные слова одного из прежних документов с повторами,
+    // почти дубликат — прежний документ из 60 слов с одним заменённым словом
+    vector<string> documents;
+    vector<int> expected_duplicates;
+    vector<int> expected_near_duplicates;
+    set<set<string>> word_sets;
+    for (int id = 0; id < 1'000; ++id) {
+        string document;
+        const int kind = id < 100 ? 0 : uniform_int_distribution(0, 4)(generator);
+        if (kind == 1) {
+            vector<string_view> words = SplitIntoWords(documents[uniform_int_distribution(0, id - 1)(generator)]);
+            words.push_back(words.front());
+            shuffle(words.begin(), words.end(), generator);
+            for (const string_view word : words) {
+                document += string(word) + ' ';
+            }
+        } else if (kind == 2) {
+            const string& original = documents[uniform_int_distribution(0, id - 1)(generator)];
+            document = original.substr(0, original.rfind(' ')) + " unique"s + to_string(id);
+        } else {
+            document = GenerateQuery(generator, dictionary, 60);
+        }
+        documents.push_back(document);
+
+        set<string> words;
+        for (const string_view word : SplitIntoWords(document)) {
+            if (word != dictionary[0]) {
+                words.emplace(word);
+            }
+        }
+        if (!word_sets.insert(words).second) {
+            expected_duplicates.push_back(id);
+            expected_near_duplicates.push_back(id);
+        } else if (kind == 2) {
+            expected_near_duplicates.push_back(id);
+        }
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 100, 5);
+
+    int mismatch_count = 0;
+    SearchServer search_server(dictionary[0]);
+    for (int id = 0; id < static_cast<int>(documents.size()); ++id) {
+        search_server.AddDocument(id, documents[id], DocumentStatus::ACTUAL, {id});
+    }
+    if (FindDuplicates(search_server) != expected_duplicates) {
+        ++mismatch_count;
+    }
+    // Почти дубликаты совпадают с оригиналом на 59 слов из 61, случайные документы почти не пересекаются
+    if (FindNearDuplicates(search_server, 0.8) != expected_near_duplicates) {
+        ++mismatch_count;
+    }
+
+    vector<NewDocument> new_documents;
+    for (int id = 0; id < static_cast<int>(documents.size()); ++id) {
+        new_documents.push_back({id, documents[id], DocumentStatus::ACTUAL, {id}});
+    }
+    for (const DuplicateMode mode : {DuplicateMode::FLAG, DuplicateMode::REJECT}) {
+        SearchServer single_server(dictionary[0]);
+        single_server.SetDuplicateMode(mode);
+        vector<int> rejected_ids;
+        for (const NewDocument& document : new_documents) {
+            try {
+                single_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            } catch (const invalid_argument&) {
+                rejected_ids.push_back(document.id);
+            }
+        }
+        SearchServer batch_server(dictionary[0]);
+        batch_server.SetDuplicateMode(mode);
+        const vector<exception_ptr> errors = batch_server.AddDocuments(execution::par, new_documents);
+        vector<int> batch_rejected_ids;
+        for (size_t i = 0; i < errors.size(); ++i) {
+            if (errors[i]) {
+                batch_rejected_ids.push_back(new_documents[i].id);
+            }
+        }
+
+        const vector<int> expected_flagged = mode == DuplicateMode::FLAG ? expected_duplicates : vector<int>{};
+        const vector<int> expected_rejected = mode == DuplicateMode::REJECT ? expected_duplicates : vector<int>{};
+        for (const SearchServer* server : {&single_server, &batch_server}) {
+            const set<int>& flagged = server->GetFlaggedDuplicates();
+            if (vector<int>(flagged.begin(), flagged.end()) != expected_flagged
+                || server->GetDocumentCount() != static_cast<int>(documents.size() - expected_rejected.size())) {
+                ++mismatch_count;
+            }
+        }
+        if (rejected_ids != expected_rejected || batch_rejected_ids != expected_rejected) {
+            ++mismatch_count;
+        }
+        for (const string& query : queries) {
+            if (!AreSameResults(batch_server.FindTopDocuments(query), single_server.FindTopDocuments(query))) {
+                ++mismatch_count;
+            }
+        }
+    }
+    cout << "duplicates mismatches: "s << mismatch_count << endl;
+}
 int main() {
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
     SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    {
+        LOG_DURATION("build index"s);
+        vector<NewDocument> new_documents;
+        new_documents.reserve(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            new_documents.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        search_server.AddDocuments(execution::par, new_documents);
     }
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    search_server.CompressIndex();
+    TEST(seq);
+    TEST(par);
+    TestPostingsScan(generator, 1'000'000, 20);
+    TestBitPacking(generator);
+    TestCompaction(generator, dictionary);
+    TestScoringKernels(generator);
+    TestImpactIndex(generator, dictionary);
+    TestConjunctiveQuery(generator, dictionary);
+    TestTextScanner(generator, dictionary);
+    TestWriteAheadLog(generator, dictionary);
+    TestSegmentedIndex(generator, dictionary);
+    TestSegmentedConcurrency(generator, dictionary);
+    TestAsyncSearch(generator, dictionary);
+    TestDuplicates(generator, dictionary);
+
+    search_server.Save("search_server.snapshot"s);
+    const SearchServer loaded_server = [] {
+        LOG_DURATION("load snapshot"s);
+        return SearchServer::Load("search_server.snapshot"s);
+    }();
+    Test("seq snapshot"sv, loaded_server, queries, execution::seq);
+    {
+        LOG_DURATION("process queries joined"s);
+        cout << ProcessQueriesJoined(search_server, queries).size() << endl;
+    }
+
+    search_server.SetQueryCacheCapacity(1000);
+    Test("seq cache miss"sv, search_server, queries, execution::seq);
+    Test("seq cache hit"sv, search_server, queries, execution::seq);
+    const QueryCacheCounters counters = search_server.GetQueryCacheCounters();
+    cout << "cache hits: "s << counters.hits << ", misses: "s << counters.misses << ", evictions: "s << counters.evictions << endl;
 }
\ No newline at end of file
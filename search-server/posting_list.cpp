@@ -0,0 +1,253 @@
+#include "posting_list.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+void PostingList::Add(uint32_t slot, double term_freq) {
+    MakeOwned();
+    if (slots_.empty() || slots_.back() < slot) {
+        slots_.push_back(slot);
+        term_freqs_.push_back(term_freq);
+        max_term_freq_ = max(max_term_freq_, term_freq);
+        UpdateDenseSlots(slot);
+        return;
+    }
+    const auto it = lower_bound(slots_.begin(), slots_.end(), slot);
+    const auto pos = it - slots_.begin();
+    if (it != slots_.end() && *it == slot) {
+        term_freqs_[pos] += term_freq;
+        max_term_freq_ = max(max_term_freq_, term_freqs_[pos]);
+        return;
+    }
+    slots_.insert(it, slot);
+    term_freqs_.insert(term_freqs_.begin() + pos, term_freq);
+    max_term_freq_ = max(max_term_freq_, term_freq);
+    UpdateDenseSlots(slot);
+}
+
+void PostingList::AddSorted(const uint32_t* slots, const double* term_freqs, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    MakeOwned();
+    if (slots_.empty() || slots_.back() < slots[0]) {
+        slots_.insert(slots_.end(), slots, slots + count);
+        term_freqs_.insert(term_freqs_.end(), term_freqs, term_freqs + count);
+        max_term_freq_ = max(max_term_freq_, *max_element(term_freqs, term_freqs + count));
+    } else {
+        vector<uint32_t> merged_slots;
+        vector<double> merged_term_freqs;
+        merged_slots.reserve(slots_.size() + count);
+        merged_term_freqs.reserve(slots_.size() + count);
+        size_t i = 0;
+        size_t j = 0;
+        while (i < slots_.size() || j < count) {
+            if (j == count || (i < slots_.size() && slots_[i] < slots[j])) {
+                merged_slots.push_back(slots_[i]);
+                merged_term_freqs.push_back(term_freqs_[i++]);
+            } else if (i == slots_.size() || slots[j] < slots_[i]) {
+                merged_slots.push_back(slots[j]);
+                merged_term_freqs.push_back(term_freqs[j++]);
+            } else {
+                merged_slots.push_back(slots_[i]);
+                merged_term_freqs.push_back(term_freqs_[i++] + term_freqs[j++]);
+            }
+        }
+        slots_.swap(merged_slots);
+        term_freqs_.swap(merged_term_freqs);
+        UpdateMaxTermFreq();
+    }
+    if (HasDenseSlots()) {
+        for (size_t i = 0; i < count; ++i) {
+            dense_slots_.Set(slots[i]);
+        }
+    } else {
+        UpdateDenseSlots(slots[count - 1]);
+    }
+}
+
+bool PostingList::Contains(uint32_t slot) const {
+    if (HasDenseSlots()) {
+        return dense_slots_.Test(slot);
+    }
+    if (is_compressed_) {
+        return compressed_.Contains(slot);
+    }
+    return binary_search(GetFlatSlots(), GetFlatSlots() + GetFlatSize(), slot);
+}
+
+void PostingList::Erase(uint32_t slot) {
+    MakeOwned();
+    const auto it = lower_bound(slots_.begin(), slots_.end(), slot);
+    if (it == slots_.end() || *it != slot) {
+        return;
+    }
+    term_freqs_.erase(term_freqs_.begin() + (it - slots_.begin()));
+    slots_.erase(it);
+    dense_slots_.Reset(slot);
+    UpdateMaxTermFreq();
+}
+
+void PostingList::EraseSlots(const vector<uint32_t>& slots) {
+    MakeOwned();
+    auto removed = slots.begin();
+    size_t new_size = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        removed = lower_bound(removed, slots.end(), slots_[i]);
+        if (removed != slots.end() && *removed == slots_[i]) {
+            dense_slots_.Reset(slots_[i]);
+            continue;
+        }
+        slots_[new_size] = slots_[i];
+        term_freqs_[new_size] = term_freqs_[i];
+        ++new_size;
+    }
+    slots_.resize(new_size);
+    term_freqs_.resize(new_size);
+    UpdateMaxTermFreq();
+}
+
+size_t PostingList::size() const {
+    return is_compressed_ ? compressed_.size() : GetFlatSize();
+}
+
+bool PostingList::empty() const {
+    return size() == 0;
+}
+
+bool PostingList::IsCompressed() const {
+    return is_compressed_;
+}
+
+void PostingList::AttachMapped(const uint32_t* slots, const double* term_freqs, size_t size, double max_term_freq) {
+    *this = PostingList{};
+    mapped_slots_ = slots;
+    mapped_term_freqs_ = term_freqs;
+    mapped_size_ = size;
+    max_term_freq_ = max_term_freq;
+    is_mapped_ = true;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+bool PostingList::HasDenseSlots() const {
+    return !dense_slots_.empty();
+}
+
+const SlotBitset& PostingList::GetDenseSlots() const {
+    return dense_slots_;
+}
+
+void PostingList::UpdateDenseSlots(uint32_t added_slot) {
+    if (HasDenseSlots()) {
+        dense_slots_.Set(added_slot);
+        return;
+    }
+    if (slots_.size() >= DENSE_MIN_SIZE && slots_.size() * DENSE_MAX_SPARSITY > slots_.back()) {
+        dense_slots_.Resize(slots_.back() + 1);
+        for (const uint32_t slot : slots_) {
+            dense_slots_.Set(slot);
+        }
+    }
+}
+
+void PostingList::Compress(const uint32_t* word_counts) {
+    if (is_compressed_ || empty()) {
+        return;
+    }
+    MakeOwned();
+    vector<uint32_t> term_counts(slots_.size());
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        const uint32_t word_count = word_counts[slots_[i]];
+        term_counts[i] = static_cast<uint32_t>(llround(term_freqs_[i] * word_count));
+        if (CompressedPostingList::ComputeTermFreq(term_counts[i], word_count) != term_freqs_[i]) {
+            return;
+        }
+    }
+    compressed_ = CompressedPostingList(slots_, term_counts);
+    is_compressed_ = true;
+    vector<uint32_t>().swap(slots_);
+    vector<double>().swap(term_freqs_);
+}
+
+void PostingList::Decompress(const uint32_t* word_counts) {
+    if (!is_compressed_) {
+        return;
+    }
+    slots_.reserve(compressed_.size());
+    term_freqs_.reserve(compressed_.size());
+    ForEachBlock(word_counts, [this](const uint32_t* slots, const double* term_freqs, size_t count) {
+        slots_.insert(slots_.end(), slots, slots + count);
+        term_freqs_.insert(term_freqs_.end(), term_freqs, term_freqs + count);
+    });
+    compressed_ = CompressedPostingList{};
+    is_compressed_ = false;
+}
+
+void PostingList::MakeOwned() {
+    if (is_compressed_) {
+        throw logic_error("Сжатый список вхождений нужно распаковать перед изменением"s);
+    }
+    if (is_mapped_) {
+        slots_.assign(mapped_slots_, mapped_slots_ + mapped_size_);
+        term_freqs_.assign(mapped_term_freqs_, mapped_term_freqs_ + mapped_size_);
+        mapped_slots_ = nullptr;
+        mapped_term_freqs_ = nullptr;
+        mapped_size_ = 0;
+        is_mapped_ = false;
+    }
+}
+
+void PostingList::UpdateMaxTermFreq() {
+    max_term_freq_ = term_freqs_.empty() ? 0.0 : *max_element(term_freqs_.begin(), term_freqs_.end());
+}
+
+PostingCursor::PostingCursor(const PostingList& postings, const uint32_t* word_counts, DecodedPostingBlock* buffer) {
+    if (postings.is_compressed_) {
+        compressed_ = &postings.compressed_;
+        word_counts_ = word_counts;
+        buffer_ = buffer;
+        LoadBlock(0);
+    } else {
+        slots_ = postings.GetFlatSlots();
+        term_freqs_ = postings.GetFlatTermFreqs();
+        size_ = postings.GetFlatSize();
+    }
+}
+
+void PostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    pos_ = 0;
+    if (block >= compressed_->GetBlockCount()) {
+        size_ = 0;
+        return;
+    }
+    size_ = compressed_->DecodeBlock(block, word_counts_, buffer_->slots, buffer_->term_freqs);
+    slots_ = buffer_->slots;
+    term_freqs_ = buffer_->term_freqs;
+}
+
+void PostingCursor::Seek(uint32_t slot) {
+    if (IsEnd() || slots_[pos_] >= slot) {
+        return;
+    }
+    if (compressed_ != nullptr && slots_[size_ - 1] < slot) {
+        LoadBlock(compressed_->FindBlock(slot, block_ + 1));
+        if (IsEnd() || slots_[pos_] >= slot) {
+            return;
+        }
+    }
+    size_t low = pos_;
+    size_t step = 1;
+    size_t high = low + step;
+    while (high < size_ && slots_[high] < slot) {
+        low = high;
+        step *= 2;
+        high = low + step;
+    }
+    const size_t end = min(high + 1, size_);
+    pos_ = lower_bound(slots_ + low + 1, slots_ + end, slot) - slots_;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "compressed_posting_list.h"
+#include "slot_bitset.h"
+
+// Распакованный блок сжатого списка; буферы для курсоров выдаёт QueryScratch
+struct DecodedPostingBlock {
+    uint32_t slots[CompressedPostingList::BLOCK_SIZE];
+    double term_freqs[CompressedPostingList::BLOCK_SIZE];
+};
+
+// Список вхождений слова: отсортированные по возрастанию слоты документов
+// и частоты слова в них, хранящиеся в двух непрерывных массивах.
+// Список можно сжать или читать из отображённого в память снимка. Отображённый список
+// при изменении сам переводится в обычные массивы, а сжатый нужно сначала распаковать
+// вызовом Decompress: частоты восстанавливаются по длинам документов, которых в нём нет.
+// Везде, где передаётся word_counts, это число слов документа по слотам — читается только у сжатого списка
+class PostingList {
+public:
+    // Добавляет вхождение документа; повторное добавление того же слота суммирует частоты
+    void Add(uint32_t slot, double term_freq);
+    // Добавляет count вхождений, отсортированных по возрастанию слотов, одним слиянием
+    void AddSorted(const uint32_t* slots, const double* term_freqs, size_t count);
+
+    bool Contains(uint32_t slot) const;
+
+    void Erase(uint32_t slot);
+    // Пакетное удаление за один проход, slots должны быть отсортированы
+    void EraseSlots(const std::vector<uint32_t>& slots);
+
+    size_t size() const;
+    bool empty() const;
+    // Наибольшая частота слова среди документов списка — для верхней оценки релевантности
+    double GetMaxTermFreq() const;
+
+    // Вызывает callback(slots, term_freqs, count) для последовательных блоков списка
+    template <typename Callback>
+    void ForEachBlock(const uint32_t* word_counts, Callback callback) const;
+    // То же без частот: callback(slots, count)
+    template <typename Callback>
+    void ForEachSlotBlock(Callback callback) const;
+
+    // Список сжимается, только если частоты восстанавливаются по word_counts без потерь
+    void Compress(const uint32_t* word_counts);
+    void Decompress(const uint32_t* word_counts);
+    bool IsCompressed() const;
+
+    // Подключает массивы из снимка без копирования; они должны жить дольше списка
+    void AttachMapped(const uint32_t* slots, const double* term_freqs, size_t size, double max_term_freq);
+
+    // У частых слов список дублируется битовым множеством слотов: проверка вхождения
+    // становится O(1), а исключение минус-слова — объединением множеств
+    bool HasDenseSlots() const;
+    const SlotBitset& GetDenseSlots() const;
+
+private:
+    // Битовое множество заводится, когда слово встречается хотя бы в 1/32 слотов —
+    // тогда оно занимает не больше памяти, чем сами слоты списка
+    static const size_t DENSE_MIN_SIZE = 64;
+    static const size_t DENSE_MAX_SPARSITY = 32;
+
+    std::vector<uint32_t> slots_;
+    std::vector<double> term_freqs_;
+    double max_term_freq_ = 0.0;
+    SlotBitset dense_slots_;
+    CompressedPostingList compressed_;
+    bool is_compressed_ = false;
+    const uint32_t* mapped_slots_ = nullptr;
+    const double* mapped_term_freqs_ = nullptr;
+    size_t mapped_size_ = 0;
+    bool is_mapped_ = false;
+
+    // Несжатые вхождения: собственные массивы или массивы снимка
+    const uint32_t* GetFlatSlots() const {
+        return is_mapped_ ? mapped_slots_ : slots_.data();
+    }
+    const double* GetFlatTermFreqs() const {
+        return is_mapped_ ? mapped_term_freqs_ : term_freqs_.data();
+    }
+    size_t GetFlatSize() const {
+        return is_mapped_ ? mapped_size_ : slots_.size();
+    }
+
+    void UpdateMaxTermFreq();
+    void UpdateDenseSlots(uint32_t added_slot);
+    // Переводит отображённый список в собственные массивы; сжатый изменять нельзя
+    void MakeOwned();
+
+    friend class PostingCursor;
+};
+
+template <typename Callback>
+void PostingList::ForEachBlock(const uint32_t* word_counts, Callback callback) const {
+    if (!is_compressed_) {
+        if (GetFlatSize() > 0) {
+            callback(GetFlatSlots(), GetFlatTermFreqs(), GetFlatSize());
+        }
+        return;
+    }
+    DecodedPostingBlock decoded;
+    for (size_t block = 0; block < compressed_.GetBlockCount(); ++block) {
+        const size_t count = compressed_.DecodeBlock(block, word_counts, decoded.slots, decoded.term_freqs);
+        callback(decoded.slots, decoded.term_freqs, count);
+    }
+}
+
+template <typename Callback>
+void PostingList::ForEachSlotBlock(Callback callback) const {
+    if (!is_compressed_) {
+        if (GetFlatSize() > 0) {
+            callback(GetFlatSlots(), GetFlatSize());
+        }
+        return;
+    }
+    uint32_t slots[CompressedPostingList::BLOCK_SIZE];
+    for (size_t block = 0; block < compressed_.GetBlockCount(); ++block) {
+        callback(slots, compressed_.DecodeSlots(block, slots));
+    }
+}
+
+// Курсор для обхода списка по возрастанию слотов; действителен, пока список не меняется.
+// Сжатый список распаковывается по одному блоку по мере продвижения курсора в buffer,
+// который должен жить не меньше курсора; для несжатого списка buffer и word_counts не нужны
+class PostingCursor {
+public:
+    PostingCursor(const PostingList& postings, const uint32_t* word_counts, DecodedPostingBlock* buffer);
+
+    bool IsEnd() const {
+        return pos_ >= size_;
+    }
+    uint32_t GetSlot() const {
+        return slots_[pos_];
+    }
+    double GetTermFreq() const {
+        return term_freqs_[pos_];
+    }
+
+    void Next() {
+        if (++pos_ == size_ && compressed_ != nullptr) {
+            LoadBlock(block_ + 1);
+        }
+    }
+    // Переходит к первому документу со слотом не меньше slot: пропускает сжатые блоки
+    // по последнему слоту, внутри блока использует экспоненциальный поиск
+    void Seek(uint32_t slot);
+
+private:
+    const uint32_t* slots_ = nullptr;
+    const double* term_freqs_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+
+    const CompressedPostingList* compressed_ = nullptr;
+    const uint32_t* word_counts_ = nullptr;
+    size_t block_ = 0;
+    DecodedPostingBlock* buffer_ = nullptr;
+
+    void LoadBlock(size_t block);
+};
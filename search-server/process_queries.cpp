@@ -1,32 +1,51 @@
-#include <execution>
-#include <functional>
+#include <algorithm>
 #include <numeric>
 
 #include "process_queries.h"
 
+QueryExecutor::QueryExecutor(size_t thread_count)
+        : pool_(thread_count) {
+}
 
-std::vector<std::vector<Document>> ProcessQueries(
-        const SearchServer& search_server,
-        const std::vector<std::string>& queries) {
+std::vector<std::vector<Document>> QueryExecutor::ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
     std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const std::string& query) {
-        return search_server.FindTopDocuments(query);
+    pool_.ParallelFor(queries.size(), [&](size_t i) {
+        result[i] = search_server.FindTopDocuments(queries[i]);
     });
     return result;
 }
 
-std::vector<Document> ProcessQueriesJoined(
-        const SearchServer& search_server,
-        const std::vector<std::string>& queries) {
-    std::vector<Document> result;
-    auto documents = ProcessQueries(search_server, queries);
-
-    result = std::reduce(std::execution::par, documents.begin(), documents.end(), result, [](std::vector<Document> left, std::vector<Document> right) {
-        std::vector<Document> temp;
-        temp.insert(temp.end(), left.begin(), left.end());
-        temp.insert(temp.end(), right.begin(), right.end());
-        return temp;
+std::vector<Document> QueryExecutor::ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    const auto documents = ProcessQueries(search_server, queries);
+    std::vector<size_t> offsets(documents.size() + 1, 0);
+    std::transform_inclusive_scan(documents.begin(), documents.end(), offsets.begin() + 1, std::plus<>{}, [](const std::vector<Document>& query_documents) {
+        return query_documents.size();
     });
 
+    std::vector<Document> result(offsets.back());
+    pool_.ParallelFor(documents.size(), [&](size_t i) {
+        std::copy(documents[i].begin(), documents[i].end(), result.begin() + offsets[i]);
+    });
     return result;
-}
\ No newline at end of file
+}
+
+namespace {
+
+QueryExecutor& GetDefaultExecutor() {
+    static QueryExecutor executor;
+    return executor;
+}
+
+}  // namespace
+
+std::vector<std::vector<Document>> ProcessQueries(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    return GetDefaultExecutor().ProcessQueries(search_server, queries);
+}
+
+std::vector<Document> ProcessQueriesJoined(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    return GetDefaultExecutor().ProcessQueriesJoined(search_server, queries);
+}
@@ -1,7 +1,35 @@
 #pragma once
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "document.h"
 #include "search_server.h"
+#include "thread_pool.h"
+
+// Выполняет пакеты запросов на собственном пуле потоков. Буферы запроса у каждого потока пула
+// свои и переиспользуются от пакета к пакету
+class QueryExecutor {
+public:
+    explicit QueryExecutor(size_t thread_count = std::thread::hardware_concurrency());
+
+    std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+    // Результаты всех запросов подряд. Размеры результатов складываются префиксной суммой,
+    // и каждый поток копирует свой результат сразу на место в заранее выделенном векторе
+    std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+    // Вызывает callback(index, documents) в вызывающем потоке в порядке запросов, как только
+    // запрос и все предыдущие выполнены. Ошибка запроса перебрасывается, когда до него доходит очередь
+    template <typename Callback>
+    void ProcessQueriesStreaming(const SearchServer& search_server, const std::vector<std::string>& queries, Callback callback);
+
+private:
+    ThreadPool pool_;
+};
 
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
@@ -9,4 +37,61 @@ std::vector<std::vector<Document>> ProcessQueries(
 
 std::vector<Document> ProcessQueriesJoined(
         const SearchServer& search_server,
-        const std::vector<std::string>& queries);
\ No newline at end of file
+        const std::vector<std::string>& queries);
+
+template <typename Callback>
+void QueryExecutor::ProcessQueriesStreaming(const SearchServer& search_server, const std::vector<std::string>& queries, Callback callback) {
+    struct Result {
+        std::vector<Document> documents;
+        std::exception_ptr error;
+        bool is_ready = false;
+    };
+    std::vector<Result> results(queries.size());
+    std::mutex mutex;
+    std::condition_variable ready;
+    size_t remaining = queries.size();
+    for (size_t i = 0; i < queries.size(); ++i) {
+        pool_.Submit([&, i] {
+            std::vector<Document> documents;
+            std::exception_ptr error;
+            try {
+                documents = search_server.FindTopDocuments(queries[i]);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard lock(mutex);
+            results[i].documents = std::move(documents);
+            results[i].error = error;
+            results[i].is_ready = true;
+            --remaining;
+            ready.notify_all();
+        });
+    }
+
+    // Задачи ссылаются на локальные переменные, поэтому выход из функции, в том числе
+    // по исключению, ждёт завершения всех задач
+    std::exception_ptr error;
+    for (size_t i = 0; i < queries.size() && !error; ++i) {
+        std::unique_lock lock(mutex);
+        ready.wait(lock, [&results, i] {
+            return results[i].is_ready;
+        });
+        lock.unlock();
+        if (results[i].error) {
+            error = results[i].error;
+            break;
+        }
+        try {
+            callback(i, std::move(results[i].documents));
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    std::unique_lock lock(mutex);
+    ready.wait(lock, [&remaining] {
+        return remaining == 0;
+    });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
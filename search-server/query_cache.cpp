@@ -0,0 +1,57 @@
+#include "query_cache.h"
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(size_t capacity)
+        : shard_capacity_(max<size_t>((capacity + SHARD_COUNT - 1) / SHARD_COUNT, 1)) {
+}
+
+bool QueryResultCache::Find(const string& key, uint64_t generation, vector<Document>& result) {
+    Shard& shard = GetShard(key);
+    {
+        lock_guard lock(shard.mutex);
+        const auto it = shard.positions.find(key);
+        if (it != shard.positions.end()) {
+            if (it->second->generation == generation) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+                result = it->second->documents;
+                hits_.fetch_add(1, memory_order_relaxed);
+                return true;
+            }
+            shard.entries.erase(it->second);
+            shard.positions.erase(it);
+        }
+    }
+    misses_.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+void QueryResultCache::Insert(const string& key, uint64_t generation, const vector<Document>& documents) {
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it != shard.positions.end()) {
+        // Тот же запрос мог успеть посчитать другой поток
+        it->second->generation = generation;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    shard.entries.push_front({key, generation, documents});
+    shard.positions.emplace(key, shard.entries.begin());
+    if (shard.entries.size() > shard_capacity_) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+        evictions_.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+QueryCacheCounters QueryResultCache::GetCounters() const {
+    return {hits_.load(memory_order_relaxed), misses_.load(memory_order_relaxed), evictions_.load(memory_order_relaxed)};
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const string& key) {
+    return shards_[hash<string>{}(key) % SHARD_COUNT];
+}
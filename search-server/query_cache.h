@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+
+struct QueryCacheCounters {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+// Кеш результатов поиска, разбитый на части со своими мьютексами, чтобы параллельные
+// запросы не ждали друг друга. В каждой части не больше capacity / SHARD_COUNT записей,
+// лишние вытесняются по давности использования. Запись помнит поколение индекса,
+// для которого посчитана: запись другого поколения считается промахом и удаляется
+class QueryResultCache {
+public:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    explicit QueryResultCache(size_t capacity);
+
+    // Ищет результат для ключа и поколения; при попадании копирует его в result
+    bool Find(const std::string& key, uint64_t generation, std::vector<Document>& result);
+    void Insert(const std::string& key, uint64_t generation, const std::vector<Document>& documents);
+
+    QueryCacheCounters GetCounters() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // Начало списка — последние использованные записи
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> positions;
+    };
+
+    size_t shard_capacity_;
+    std::array<Shard, SHARD_COUNT> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+    Shard& GetShard(const std::string& key);
+};
@@ -0,0 +1,56 @@
+#include "query_scratch.h"
+#include <algorithm>
+
+using namespace std;
+
+void QueryScratch::Reset(size_t slot_count) {
+    if (relevance.size() < slot_count) {
+        relevance.resize(slot_count);
+        stamps.resize(slot_count, 0);
+    }
+    if (has_exclusions) {
+        excluded.Clear();
+        has_exclusions = false;
+    }
+    excluded.Resize(slot_count);
+    // Нулевая метка означает «не затронут», поэтому при переполнении счётчика метки сбрасываются
+    if (++generation == 0) {
+        fill(stamps.begin(), stamps.end(), 0);
+        generation = 1;
+    }
+    candidates.clear();
+    terms.clear();
+    upper_bounds.clear();
+    term_scores.clear();
+    impact_tiers.clear();
+    dense_slots.clear();
+    used_decoded_blocks = 0;
+}
+
+DecodedPostingBlock* QueryScratch::AcquireDecodedBlock() {
+    if (used_decoded_blocks == decoded_blocks.size()) {
+        decoded_blocks.push_back(make_unique<DecodedPostingBlock>());
+    }
+    return decoded_blocks[used_decoded_blocks++].get();
+}
+
+void QueryScratch::Exclude(const PostingList& postings) {
+    if (postings.empty()) {
+        return;
+    }
+    has_exclusions = true;
+    if (postings.HasDenseSlots()) {
+        excluded.Union(postings.GetDenseSlots());
+        return;
+    }
+    postings.ForEachSlotBlock([this](const uint32_t* slots, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            excluded.Set(slots[i]);
+        }
+    });
+}
+
+QueryScratch& QueryScratch::ForCurrentThread() {
+    thread_local QueryScratch scratch;
+    return scratch;
+}
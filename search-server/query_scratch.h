@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "posting_list.h"
+#include "scoring_kernel.h"
+#include "slot_bitset.h"
+
+// Рабочие буферы запроса. Создаются один раз на поток и переиспользуются между запросами,
+// так что после прогрева запрос не выделяет под них память
+struct QueryScratch {
+    struct TermCursor {
+        PostingCursor cursor;
+        size_t query_index;
+        TermScoring scoring;
+        double max_score;
+    };
+
+    // Уровень списка слова запроса при обходе по уровням вклада; список без копии
+    // по вкладу (postings != nullptr) — один уровень
+    struct ImpactTier {
+        size_t query_index;
+        const PostingList* postings;
+        const uint32_t* slots;
+        const double* term_freqs;
+        size_t size;
+        double max_score;
+    };
+
+    // Плотный аккумулятор релевантности по слотам документов;
+    // relevance[slot] действительно, только если stamps[slot] == generation
+    std::vector<double> relevance;
+    std::vector<uint32_t> stamps;
+    uint32_t generation = 0;
+    // Слоты, затронутые запросом, в порядке первого обращения
+    std::vector<uint32_t> candidates;
+    // Документы с минус-словами, собираются до подсчёта релевантности
+    SlotBitset excluded;
+    bool has_exclusions = false;
+
+    // Буферы обхода документ за документом
+    std::vector<TermCursor> terms;
+    std::vector<double> upper_bounds;
+    std::vector<double> term_scores;
+    // Буферы обхода по уровням вклада: биты слов запроса, уже учтённых в relevance[slot],
+    // и накопленные релевантности кандидатов. seen_terms заводится при первом таком поиске.
+    // Наибольшие вклады слов в непройденных уровнях хранятся в upper_bounds
+    std::vector<uint64_t> seen_terms;
+    std::vector<double> candidate_relevance;
+    std::vector<TermScoring> term_scorings;
+    std::vector<ImpactTier> impact_tiers;
+    // Битовые множества слотов обязательных слов при поиске с «+», кроме ведущего
+    std::vector<const SlotBitset*> dense_slots;
+    // Буферы распаковки блоков для курсоров по сжатым спискам; первые used_decoded_blocks заняты.
+    // Блоки лежат отдельно, чтобы их адреса не менялись при росте пула
+    std::vector<std::unique_ptr<DecodedPostingBlock>> decoded_blocks;
+    size_t used_decoded_blocks = 0;
+
+    // Начинает новый запрос по индексу из slot_count слотов
+    void Reset(size_t slot_count);
+
+    void Accumulate(uint32_t slot, double score) {
+        if (stamps[slot] != generation) {
+            stamps[slot] = generation;
+            relevance[slot] = score;
+            candidates.push_back(slot);
+        } else {
+            relevance[slot] += score;
+        }
+    }
+
+    void Accumulate(uint32_t slot, double score, uint64_t term_bit) {
+        if (stamps[slot] != generation) {
+            stamps[slot] = generation;
+            relevance[slot] = score;
+            seen_terms[slot] = term_bit;
+            candidates.push_back(slot);
+        } else {
+            relevance[slot] += score;
+            seen_terms[slot] |= term_bit;
+        }
+    }
+
+    // Выдаёт свободный буфер распаковки до следующего Reset
+    DecodedPostingBlock* AcquireDecodedBlock();
+
+    // Исключает из выдачи все документы списка
+    void Exclude(const PostingList& postings);
+
+    bool IsExcluded(uint32_t slot) const {
+        return has_exclusions && excluded.Test(slot);
+    }
+
+    static QueryScratch& ForCurrentThread();
+};
@@ -1,21 +1,122 @@
 #include "remove_duplicates.h"
+#include <cmath>
+#include <unordered_set>
+
+namespace {
+
+std::vector<int> GetDocumentIds(const SearchServer& search_server) {
+    return {search_server.begin(), search_server.end()};
+}
+
+// Одна запись в поток вместо строки с endl на каждый дубликат
+void RemoveAndReport(SearchServer& search_server, const std::vector<int>& duplicates) {
+    std::string report;
+    for (const int document_id : duplicates) {
+        report += "Found duplicate document id " + std::to_string(document_id) + '\n';
+    }
+    std::cout << report << std::flush;
+    search_server.RemoveDocuments(duplicates);
+}
+
+// Наибольшая ширина полосы, при которой порог срабатывания LSH (1/b)^(1/r) не выше заданного:
+// широкие полосы дают меньше лишних кандидатов
+size_t GetBandWidth(double similarity_threshold) {
+    size_t band_width = 1;
+    for (size_t width = 2; width <= MIN_HASH_SIZE; ++width) {
+        const double band_count = static_cast<double>(MIN_HASH_SIZE / width);
+        if (std::pow(1.0 / band_count, 1.0 / width) <= similarity_threshold) {
+            band_width = width;
+        }
+    }
+    return band_width;
+}
+
+uint64_t HashBand(const MinHashSignature& signature, size_t begin, size_t end) {
+    uint64_t hash = begin;
+    for (size_t i = begin; i < end; ++i) {
+        hash = MixBits(hash ^ signature[i]);
+    }
+    return hash;
+}
+
+}  // namespace
+
+std::vector<int> FindDuplicates(const SearchServer& search_server) {
+    const std::vector<int> document_ids = GetDocumentIds(search_server);
+    std::vector<DocumentFingerprint> fingerprints(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+                   [&search_server](int document_id) {
+                       return search_server.GetDocumentFingerprint(document_id);
+                   });
+
+    std::vector<int> duplicates;
+    std::unordered_set<DocumentFingerprint, DocumentFingerprintHasher> seen;
+    seen.reserve(document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (!seen.insert(fingerprints[i]).second) {
+            duplicates.push_back(document_ids[i]);
+        }
+    }
+    return duplicates;
+}
 
 void RemoveDuplicates(SearchServer& search_server) {
+    RemoveAndReport(search_server, FindDuplicates(search_server));
+}
+
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double similarity_threshold) {
+    if (!(similarity_threshold > 0.0 && similarity_threshold <= 1.0)) {
+        throw std::invalid_argument("Similarity threshold must be in (0, 1]");
+    }
+    const std::vector<int> document_ids = GetDocumentIds(search_server);
+    std::vector<MinHashSignature> signatures(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), signatures.begin(),
+                   [&search_server](int document_id) {
+                       return search_server.GetDocumentMinHash(document_id);
+                   });
+
+    const size_t band_width = GetBandWidth(similarity_threshold);
+    const size_t band_count = MIN_HASH_SIZE / band_width;
+    // Оставленные документы с одинаковым хешем полосы связаны в список:
+    // bucket_heads[band] — хеш полосы -> последний документ, next[band * n + i] — предыдущий
+    const size_t document_count = document_ids.size();
+    const size_t no_document = document_count;
+    std::vector<std::unordered_map<uint64_t, size_t>> bucket_heads(band_count);
+    for (auto& heads : bucket_heads) {
+        heads.reserve(document_count);
+    }
+    std::vector<size_t> next(band_count * document_count, no_document);
+    std::vector<uint64_t> band_hashes(band_count);
     std::vector<int> duplicates;
-    std::map<std::set<std::string>, int> set_of_words_to_id;
-    for (const int document_id: search_server) {
-        std::set<std::string> words_set;
-        for (auto& words: search_server.GetWordFrequencies(document_id)) {
-            words_set.insert(std::string{words.first});
+    for (size_t i = 0; i < document_count; ++i) {
+        const MinHashSignature& signature = signatures[i];
+        bool is_duplicate = false;
+        for (size_t band = 0; band < band_count && !is_duplicate; ++band) {
+            band_hashes[band] = HashBand(signature, band * band_width, (band + 1) * band_width);
+            const auto it = bucket_heads[band].find(band_hashes[band]);
+            if (it == bucket_heads[band].end()) {
+                continue;
+            }
+            for (size_t candidate = it->second; candidate != no_document && !is_duplicate;
+                 candidate = next[band * document_count + candidate]) {
+                is_duplicate = EstimateSimilarity(signature, signatures[candidate]) >= similarity_threshold;
+            }
         }
-        if (set_of_words_to_id.count(words_set)) {
-            std::cout << "Found duplicate document id " << document_id << std::endl;
-            duplicates.push_back(document_id);
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[i]);
+            continue;
+        }
+        for (size_t band = 0; band < band_count; ++band) {
+            const auto [it, inserted] = bucket_heads[band].emplace(band_hashes[band], i);
+            if (!inserted) {
+                next[band * document_count + i] = it->second;
+                it->second = i;
+            }
         }
-        else set_of_words_to_id[words_set] = document_id;
     }
+    return duplicates;
+}
 
-    for (auto id: duplicates) {
-        search_server.RemoveDocument(id);
-    }
-}
\ No newline at end of file
+void RemoveNearDuplicates(SearchServer& search_server, double similarity_threshold) {
+    RemoveAndReport(search_server, FindNearDuplicates(search_server, similarity_threshold));
+}
@@ -1,4 +1,14 @@
 #pragma once
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+// Id документов, набор слов которых совпадает с набором слов документа с меньшим id.
+// Отпечатки считаются параллельно
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+void RemoveDuplicates(SearchServer& search_server);
+
+// Id документов, сходство которых по Жаккару с одним из оставленных документов с меньшим id
+// не меньше similarity_threshold (0 < similarity_threshold <= 1). Сходство оценивается по MinHash,
+// кандидаты подбираются по совпадению полос сигнатуры (LSH), поэтому часть пар около порога
+// может быть пропущена
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double similarity_threshold);
+void RemoveNearDuplicates(SearchServer& search_server, double similarity_threshold);
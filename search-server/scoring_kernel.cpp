@@ -0,0 +1,172 @@
+#include "scoring_kernel.h"
+#include <initializer_list>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCORING_KERNEL_HAS_SIMD
+#endif
+
+using namespace std;
+
+TermScoring MakeTfIdfScoring(double inverse_document_freq) {
+    TermScoring scoring;
+    scoring.inverse_document_freq = inverse_document_freq;
+    return scoring;
+}
+
+TermScoring MakeBm25Scoring(double inverse_document_freq, const Bm25Parameters& parameters, double average_document_length) {
+    TermScoring scoring;
+    scoring.model = RankingModel::BM25;
+    scoring.inverse_document_freq = inverse_document_freq;
+    scoring.saturation = parameters.k1 + 1.0;
+    scoring.length_base = parameters.k1 * (1.0 - parameters.b);
+    scoring.length_scale = parameters.k1 * parameters.b / average_document_length;
+    return scoring;
+}
+
+__attribute__((optimize("fp-contract=off")))
+double ScoreBm25(const TermScoring& scoring, double term_freq, double document_length) {
+    const double count = term_freq * document_length;
+    const double length_norm = scoring.length_base + scoring.length_scale * document_length;
+    return scoring.inverse_document_freq * (scoring.saturation * count / (count + length_norm));
+}
+
+__attribute__((optimize("fp-contract=off")))
+double ScorePosting(const TermScoring& scoring, double term_freq, const uint32_t* document_lengths, uint32_t slot) {
+    if (scoring.model == RankingModel::TF_IDF) {
+        return term_freq * scoring.inverse_document_freq;
+    }
+    return ScoreBm25(scoring, term_freq, document_lengths[slot]);
+}
+
+__attribute__((optimize("fp-contract=off")))
+double GetMaxPostingScore(const TermScoring& scoring, double max_term_freq, uint32_t max_document_length) {
+    if (scoring.model == RankingModel::TF_IDF) {
+        return max_term_freq * scoring.inverse_document_freq;
+    }
+    return ScoreBm25(scoring, max_term_freq, max_document_length);
+}
+
+namespace {
+
+// Хвосты пачек векторных реализаций досчитываются здесь, и при сборке под процессор с FMA
+// сворачивание умножения со сложением запрещено и в скалярной реализации
+__attribute__((optimize("fp-contract=off")))
+void ScoreScalar(const TermScoring& scoring, const uint32_t* slots, const double* term_freqs, size_t begin, size_t count,
+                 const uint32_t* document_lengths, double* scores) {
+    for (size_t i = begin; i < count; ++i) {
+        scores[i] = ScorePosting(scoring, term_freqs[i], document_lengths, slots[i]);
+    }
+}
+
+#ifdef SCORING_KERNEL_HAS_SIMD
+// Операции те же и в том же порядке, что в ScoreBm25, и без FMA, поэтому результат совпадает со скалярным:
+// при сборке под процессор с FMA умножение со сложением свернулось бы в одну инструкцию, и это запрещено явно.
+// Слоты и длины документов меньше 2^31 и читаются как знаковые
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+void ScoreAvx2(const TermScoring& scoring, const uint32_t* slots, const double* term_freqs, size_t count,
+               const uint32_t* document_lengths, double* scores) {
+    const __m256d inverse_document_freq = _mm256_set1_pd(scoring.inverse_document_freq);
+    size_t i = 0;
+    if (scoring.model == RankingModel::TF_IDF) {
+        for (; i + 4 <= count; i += 4) {
+            _mm256_storeu_pd(scores + i, _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), inverse_document_freq));
+        }
+    } else {
+        const __m256d saturation = _mm256_set1_pd(scoring.saturation);
+        const __m256d length_base = _mm256_set1_pd(scoring.length_base);
+        const __m256d length_scale = _mm256_set1_pd(scoring.length_scale);
+        const int* lengths = reinterpret_cast<const int*>(document_lengths);
+        for (; i + 4 <= count; i += 4) {
+            const __m128i slot = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i));
+            const __m256d length = _mm256_cvtepi32_pd(_mm_i32gather_epi32(lengths, slot, 4));
+            const __m256d term_count = _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), length);
+            const __m256d length_norm = _mm256_add_pd(length_base, _mm256_mul_pd(length_scale, length));
+            const __m256d ratio = _mm256_div_pd(_mm256_mul_pd(saturation, term_count), _mm256_add_pd(term_count, length_norm));
+            _mm256_storeu_pd(scores + i, _mm256_mul_pd(inverse_document_freq, ratio));
+        }
+    }
+    ScoreScalar(scoring, slots, term_freqs, i, count, document_lengths, scores);
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+void ScoreAvx512(const TermScoring& scoring, const uint32_t* slots, const double* term_freqs, size_t count,
+                 const uint32_t* document_lengths, double* scores) {
+    const __m512d inverse_document_freq = _mm512_set1_pd(scoring.inverse_document_freq);
+    size_t i = 0;
+    if (scoring.model == RankingModel::TF_IDF) {
+        for (; i + 8 <= count; i += 8) {
+            _mm512_storeu_pd(scores + i, _mm512_mul_pd(_mm512_loadu_pd(term_freqs + i), inverse_document_freq));
+        }
+    } else {
+        const __m512d saturation = _mm512_set1_pd(scoring.saturation);
+        const __m512d length_base = _mm512_set1_pd(scoring.length_base);
+        const __m512d length_scale = _mm512_set1_pd(scoring.length_scale);
+        for (; i + 8 <= count; i += 8) {
+            const __m256i slot = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + i));
+            const __m256i lengths = _mm256_i32gather_epi32(reinterpret_cast<const int*>(document_lengths), slot, 4);
+            const __m512d length = _mm512_maskz_cvtepi32_pd(0xFF, lengths);
+            const __m512d term_count = _mm512_mul_pd(_mm512_loadu_pd(term_freqs + i), length);
+            const __m512d length_norm = _mm512_add_pd(length_base, _mm512_mul_pd(length_scale, length));
+            const __m512d ratio = _mm512_div_pd(_mm512_mul_pd(saturation, term_count), _mm512_add_pd(term_count, length_norm));
+            _mm512_storeu_pd(scores + i, _mm512_mul_pd(inverse_document_freq, ratio));
+        }
+    }
+    ScoreScalar(scoring, slots, term_freqs, i, count, document_lengths, scores);
+}
+#endif
+
+}  // namespace
+
+bool IsScoringKernelSupported(ScoringKernel kernel) {
+    switch (kernel) {
+        case ScoringKernel::SCALAR:
+            return true;
+        case ScoringKernel::AVX2:
+#ifdef SCORING_KERNEL_HAS_SIMD
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        case ScoringKernel::AVX512:
+#ifdef SCORING_KERNEL_HAS_SIMD
+            return __builtin_cpu_supports("avx512f");
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+ScoringKernel GetBestScoringKernel() {
+    static const ScoringKernel kernel = [] {
+        for (const ScoringKernel kernel : {ScoringKernel::AVX512, ScoringKernel::AVX2}) {
+            if (IsScoringKernelSupported(kernel)) {
+                return kernel;
+            }
+        }
+        return ScoringKernel::SCALAR;
+    }();
+    return kernel;
+}
+
+void ScorePostings(const TermScoring& scoring, const uint32_t* slots, const double* term_freqs, size_t count,
+                   const uint32_t* document_lengths, double* scores) {
+    ScorePostings(GetBestScoringKernel(), scoring, slots, term_freqs, count, document_lengths, scores);
+}
+
+void ScorePostings(ScoringKernel kernel, const TermScoring& scoring, const uint32_t* slots, const double* term_freqs, size_t count,
+                   const uint32_t* document_lengths, double* scores) {
+    switch (IsScoringKernelSupported(kernel) ? kernel : ScoringKernel::SCALAR) {
+#ifdef SCORING_KERNEL_HAS_SIMD
+        case ScoringKernel::AVX512:
+            ScoreAvx512(scoring, slots, term_freqs, count, document_lengths, scores);
+            return;
+        case ScoringKernel::AVX2:
+            ScoreAvx2(scoring, slots, term_freqs, count, document_lengths, scores);
+            return;
+#endif
+        default:
+            ScoreScalar(scoring, slots, term_freqs, 0, count, document_lengths, scores);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Модель релевантности документа запросу
+enum class RankingModel {
+    // Сумма tf * idf слов запроса
+    TF_IDF,
+    // Okapi BM25: вклад частоты слова насыщается, длинные документы штрафуются
+    BM25,
+};
+
+struct Bm25Parameters {
+    double k1 = 1.2;
+    double b = 0.75;
+};
+
+// Вклад одного слова запроса в релевантность. Для BM25 частота слова в документе
+// count = tf * length, и вклад равен idf * saturation * count / (count + length_base + length_scale * length)
+struct TermScoring {
+    RankingModel model = RankingModel::TF_IDF;
+    double inverse_document_freq = 0.0;
+    // k1 + 1, k1 * (1 - b) и k1 * b / средняя длина документа
+    double saturation = 0.0;
+    double length_base = 0.0;
+    double length_scale = 0.0;
+};
+
+TermScoring MakeTfIdfScoring(double inverse_document_freq);
+TermScoring MakeBm25Scoring(double inverse_document_freq, const Bm25Parameters& parameters, double average_document_length);
+
+// Скалярные оценки определены в scoring_kernel.cpp, а не встраиваются: там они собраны без сворачивания
+// умножения со сложением в FMA, и вызывающий код, собранный под любой процессор, получает те же значения,
+// что и векторные реализации ScorePostings
+double ScoreBm25(const TermScoring& scoring, double term_freq, double document_length);
+
+// Вклад вхождения с частотой term_freq (доля слов документа) в документ в слоте slot;
+// document_lengths — длины документов по слотам, читаются только для BM25
+double ScorePosting(const TermScoring& scoring, double term_freq, const uint32_t* document_lengths, uint32_t slot);
+
+// Верхняя оценка вклада: вклад растёт и с частотой слова, и с длиной документа
+double GetMaxPostingScore(const TermScoring& scoring, double max_term_freq, uint32_t max_document_length);
+
+// Оценка пачки вхождений: scores[i] = ScorePosting(scoring, term_freqs[i], document_lengths, slots[i]).
+// Реализации на AVX2 и AVX-512 дают те же значения бит в бит, что и скалярная;
+// лучшая из доступных выбирается при запуске по возможностям процессора
+enum class ScoringKernel {
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+ScoringKernel GetBestScoringKernel();
+bool IsScoringKernelSupported(ScoringKernel kernel);
+
+void ScorePostings(const TermScoring& scoring, const uint32_t* slots, const double* term_freqs, size_t count,
+                   const uint32_t* document_lengths, double* scores);
+// Неподдерживаемая процессором реализация заменяется скалярной
+void ScorePostings(ScoringKernel kernel, const TermScoring& scoring, const uint32_t* slots, const double* term_freqs, size_t count,
+                   const uint32_t* document_lengths, double* scores);
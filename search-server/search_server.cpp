@@ -9,49 +9,273 @@ SearchServer::SearchServer(const std::string &stop_words_text) : SearchServer(Sp
 SearchServer::SearchServer(const std::string_view stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)){}
 
 void SearchServer::AddDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
-    if (documents_.count(document_id) > 0) {
+    // Проверка текста и разбиение на слова — один проход
+    vector<string_view> words;
+    CheckNewDocument(document_id, TokenizeText(document, words));
+    RemoveStopWords(words);
+    const bool is_duplicate = CheckDuplicate(words);
+    if (log_) {
+        log_sequence_number_ = log_->LogAddDocument(document_id, document, status, ratings);
+        log_->WaitDurable(log_sequence_number_);
+    }
+    AddDocumentWords(document_id, words, status, ratings);
+    if (is_duplicate) {
+        flagged_duplicates_.insert(document_id);
+    }
+}
+
+vector<exception_ptr> SearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    return AddDocuments(execution::seq, documents);
+}
+
+void SearchServer::CheckNewDocument(int document_id, bool is_valid_text) const {
+    if (document_to_slot_.count(document_id) > 0) {
         throw invalid_argument("Документ с таким id уже существует."s);
     }
     else if (document_id < 0) {
         throw invalid_argument("Документ не может иметь отрицательный id."s);
     }
-    else if (!IsValidWord(document)) {
+    else if (!is_valid_text) {
         throw invalid_argument("Содержимое документа содержит недопустимые символы"s);
     }
-    const vector<string_view> words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
+}
+
+void SearchServer::AddDocumentWords(int document_id, const vector<string_view>& words, DocumentStatus status, const vector<int>& ratings) {
+    vector<uint32_t> term_ids;
+    term_ids.reserve(words.size());
     for (const string_view& word : words) {
-        word_to_document_freqs_[std::string{word}][document_id] += inv_word_count;
-        words_to_id_[document_id][word_to_document_freqs_.find(word)->first] += inv_word_count;
+        term_ids.push_back(terms_.Intern(word));
+    }
+    if (word_to_document_freqs_.size() < terms_.size()) {
+        word_to_document_freqs_.resize(terms_.size());
+    }
+    const vector<TermFreq> word_freqs = ComputeTermFreqs(term_ids);
+
+    const uint32_t slot = AllocateSlot({document_id, ComputeAverageRating(ratings), status, static_cast<uint32_t>(words.size())});
+    forward_index_.Set(slot, word_freqs);
+    for (const TermFreq& term_freq : word_freqs) {
+        GetMutablePostings(term_freq.term_id).Add(slot, term_freq.freq);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
     document_ids_.insert(document_id);
+    RegisterFingerprint(document_id);
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string_view& raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+uint32_t SearchServer::AllocateSlot(const DocumentData& document_data) {
+    uint32_t slot;
+    if (free_slots_.empty()) {
+        slot = static_cast<uint32_t>(documents_.size());
+        documents_.push_back(document_data);
+    } else {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        documents_[slot] = document_data;
+    }
+    for (SlotBitset& slots : status_slots_) {
+        slots.Reset(slot);
+    }
+    const size_t status = static_cast<size_t>(document_data.status);
+    if (status < STATUS_COUNT) {
+        status_slots_[status].Set(slot);
+    }
+    document_lengths_.resize(documents_.size());
+    document_lengths_[slot] = document_data.word_count;
+    document_ratings_.resize(documents_.size());
+    document_ratings_[slot] = document_data.rating;
+    document_id_column_.resize(documents_.size());
+    document_id_column_[slot] = document_data.id;
+    CountDocumentLength(slot);
+    document_to_slot_.emplace(document_data.id, slot);
+    ReleaseImpactIndex();
+    ++generation_;
+    return slot;
+}
+
+vector<SearchServer::TermFreq> SearchServer::ComputeTermFreqs(vector<uint32_t>& term_ids) {
+    const double inv_word_count = 1.0 / term_ids.size();
+    sort(term_ids.begin(), term_ids.end());
+    vector<TermFreq> word_freqs;
+    for (const uint32_t term_id : term_ids) {
+        if (word_freqs.empty() || word_freqs.back().term_id != term_id) {
+            word_freqs.push_back({term_id, 0.0});
+        }
+        word_freqs.back().freq += inv_word_count;
+    }
+    return word_freqs;
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view& raw_query, DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, top_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view& raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename ExecutionPolicy>
-vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const string_view& raw_query) const {
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+vector<Document> SearchServer::FindTopDocuments(execution::sequenced_policy policy, const string_view& raw_query, DocumentStatus status, size_t top_count) const {
+    const StatusIs document_predicate{status};
+    if (!query_cache_) {
+        return FindTopDocuments(policy, raw_query, document_predicate, top_count);
+    }
+    Query query;
+    ParseQuery(raw_query, query);
+    if (!IsValidWord(raw_query)) {
+        throw std::invalid_argument("Содержимое запроса содержит недопустимые символы");
+    }
+    const string key = MakeQueryCacheKey(query, status, top_count);
+    vector<Document> result;
+    if (!query_cache_->Find(key, generation_, result)) {
+        result = FindTopDocuments(query, document_predicate, top_count);
+        query_cache_->Insert(key, generation_, result);
+    }
+    return result;
 }
 
-template <typename ExecutionPolicy>
-vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const string_view& raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+vector<Document> SearchServer::FindTopDocuments(execution::parallel_policy policy, const string_view& raw_query, DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(policy, raw_query, StatusIs{status}, top_count);
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    query_cache_ = capacity > 0 ? make_unique<QueryResultCache>(capacity) : nullptr;
+}
+
+void SearchServer::SetRankingModel(RankingModel model, const Bm25Parameters& parameters) {
+    if (!(parameters.k1 >= 0.0 && parameters.b >= 0.0 && parameters.b <= 1.0)) {
+        throw invalid_argument("Параметры BM25: k1 >= 0, 0 <= b <= 1"s);
+    }
+    ranking_model_ = model;
+    bm25_parameters_ = parameters;
+    // Списки по вкладу упорядочены по прежней модели
+    ReleaseImpactIndex();
+    // Результаты в кеше посчитаны по прежней модели
+    ++generation_;
+}
+
+QueryCacheCounters SearchServer::GetQueryCacheCounters() const {
+    return query_cache_ ? query_cache_->GetCounters() : QueryCacheCounters{};
+}
+
+// Слова запроса уже отсортированы и без повторов, поэтому одинаковые по смыслу запросы
+// дают один ключ независимо от порядка и повторов слов
+string SearchServer::MakeQueryCacheKey(const Query& query, DocumentStatus status, size_t top_count) {
+    string key;
+    key.reserve((query.plus_words.size() + query.required_words.size() + query.minus_words.size() + 3) * sizeof(uint32_t) + 2 * sizeof(uint64_t));
+    const auto append = [&key](auto value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append(static_cast<uint64_t>(top_count));
+    append(static_cast<uint32_t>(status));
+    append(static_cast<uint32_t>(query.plus_words.size()));
+    for (const uint32_t term_id : query.plus_words) {
+        append(term_id);
+    }
+    // Пропавшее обязательное слово отмечается числом, которое не может быть числом слов
+    append(query.has_missing_required_word ? numeric_limits<uint32_t>::max() : static_cast<uint32_t>(query.required_words.size()));
+    for (const uint32_t term_id : query.required_words) {
+        append(term_id);
+    }
+    for (const uint32_t term_id : query.minus_words) {
+        append(term_id);
+    }
+    return key;
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_to_slot_.size();
+}
+
+bool SearchServer::HasDocument(int document_id) const {
+    return document_to_slot_.count(document_id) > 0;
+}
+
+DocumentFingerprint SearchServer::GetDocumentFingerprint(int document_id) const {
+    const ForwardIndex::Entries words = GetDocumentWords(document_id);
+    FingerprintBuilder builder;
+    for (size_t i = 0; i < words.size; ++i) {
+        builder.Add(words.term_ids[i]);
+    }
+    return builder.Get();
+}
+
+MinHashSignature SearchServer::GetDocumentMinHash(int document_id) const {
+    const ForwardIndex::Entries words = GetDocumentWords(document_id);
+    MinHashBuilder builder;
+    for (size_t i = 0; i < words.size; ++i) {
+        builder.Add(words.term_ids[i]);
+    }
+    return builder.Get();
+}
+
+void SearchServer::SetDuplicateMode(DuplicateMode mode) {
+    if (mode == DuplicateMode::IGNORE) {
+        fingerprint_counts_.clear();
+        flagged_duplicates_.clear();
+    } else if (duplicate_mode_ == DuplicateMode::IGNORE) {
+        const vector<int> document_ids(document_ids_.begin(), document_ids_.end());
+        vector<DocumentFingerprint> fingerprints(document_ids.size());
+        transform(execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(), [this](int document_id) {
+            return GetDocumentFingerprint(document_id);
+        });
+        for (const DocumentFingerprint& fingerprint : fingerprints) {
+            ++fingerprint_counts_[fingerprint];
+        }
+    }
+    duplicate_mode_ = mode;
+}
+
+const set<int>& SearchServer::GetFlaggedDuplicates() const {
+    return flagged_duplicates_;
+}
+
+void SearchServer::RegisterFingerprint(int document_id) {
+    if (duplicate_mode_ != DuplicateMode::IGNORE) {
+        ++fingerprint_counts_[GetDocumentFingerprint(document_id)];
+    }
+}
+
+void SearchServer::UnregisterFingerprint(int document_id) {
+    if (duplicate_mode_ == DuplicateMode::IGNORE) {
+        return;
+    }
+    const auto it = fingerprint_counts_.find(GetDocumentFingerprint(document_id));
+    if (it != fingerprint_counts_.end() && --it->second == 0) {
+        fingerprint_counts_.erase(it);
+    }
+    flagged_duplicates_.erase(document_id);
+}
+
+bool SearchServer::FindNewDocumentFingerprint(const vector<string_view>& words, DocumentFingerprint& fingerprint) const {
+    vector<uint32_t> term_ids;
+    term_ids.reserve(words.size());
+    for (const string_view word : words) {
+        const uint32_t term_id = terms_.Find(word);
+        if (term_id == TermDictionary::NO_TERM) {
+            return false;
+        }
+        term_ids.push_back(term_id);
+    }
+    sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    FingerprintBuilder builder;
+    for (const uint32_t term_id : term_ids) {
+        builder.Add(term_id);
+    }
+    fingerprint = builder.Get();
+    return true;
+}
+
+bool SearchServer::CheckDuplicate(const vector<string_view>& words) const {
+    DocumentFingerprint fingerprint;
+    const bool is_duplicate = duplicate_mode_ != DuplicateMode::IGNORE && FindNewDocumentFingerprint(words, fingerprint)
+                              && fingerprint_counts_.count(fingerprint) > 0;
+    if (is_duplicate && duplicate_mode_ == DuplicateMode::REJECT) {
+        throw invalid_argument("Документ с таким набором слов уже существует."s);
+    }
+    return is_duplicate;
+}
+
+int SearchServer::GetDocumentFreq(string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    return term_id == TermDictionary::NO_TERM ? 0 : static_cast<int>(GetLiveDocumentFreq(term_id));
 }
 
 set<int>::const_iterator SearchServer::begin() const {
@@ -62,21 +286,402 @@ set<int>::const_iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
-const map<string_view, double, less<>> SearchServer::GetWordFrequencies(int document_id) const {
-    static const map<string_view, double, std::less<>> empty_map;
-    if (!words_to_id_.count(document_id)) {
-        return empty_map;
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const auto slot_it = document_to_slot_.find(document_id);
+    if (slot_it == document_to_slot_.end()) {
+        return {};
     }
-    return words_to_id_.at(document_id);
+    return {&terms_, forward_index_.Get(slot_it->second)};
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    documents_.erase(document_id);
+    const uint32_t slot = document_to_slot_.at(document_id);
+    if (log_) {
+        log_sequence_number_ = log_->LogRemoveDocument(document_id);
+        log_->WaitDurable(log_sequence_number_);
+    }
+    MarkDeleted(document_id, slot);
+    CompactIfNeeded();
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    for (const int document_id : document_ids) {
+        const auto slot_it = document_to_slot_.find(document_id);
+        if (slot_it == document_to_slot_.end()) {
+            continue;
+        }
+        if (log_) {
+            log_sequence_number_ = log_->LogRemoveDocument(document_id);
+        }
+        MarkDeleted(document_id, slot_it->second);
+    }
+    if (log_) {
+        log_->WaitDurable(log_sequence_number_);
+    }
+    CompactIfNeeded();
+}
+
+void SearchServer::CountDocumentLength(uint32_t slot) {
+    total_document_length_ += document_lengths_[slot];
+    max_document_length_ = max(max_document_length_, document_lengths_[slot]);
+}
+
+void SearchServer::MarkDeleted(int document_id, uint32_t slot) {
+    if (deleted_postings_.size() < terms_.size()) {
+        deleted_postings_.resize(terms_.size());
+    }
+    const ForwardIndex::Entries words = GetDocumentWords(document_id);
+    for (size_t i = 0; i < words.size; ++i) {
+        ++deleted_postings_[words.term_ids[i]];
+    }
+    UnregisterFingerprint(document_id);
+    forward_index_.Clear(slot);
+    total_document_length_ -= document_lengths_[slot];
+    document_to_slot_.erase(document_id);
     document_ids_.erase(document_id);
-    for (auto &words: words_to_id_.at(document_id)) {
-        word_to_document_freqs_[std::string{words.first}].erase(document_id);
+    deleted_slots_.Set(slot);
+    deleted_slot_list_.push_back(slot);
+    ReleaseImpactIndex();
+    ++generation_;
+}
+
+void SearchServer::CompactIfNeeded() {
+    const size_t occupied_count = document_to_slot_.size() + deleted_slot_list_.size();
+    if (deleted_slot_list_.size() > compaction_threshold_ * occupied_count) {
+        Compact();
+    }
+}
+
+void SearchServer::Compact() {
+    if (deleted_slot_list_.empty()) {
+        return;
+    }
+    sort(deleted_slot_list_.begin(), deleted_slot_list_.end());
+    vector<uint32_t> term_ids;
+    for (uint32_t term_id = 0; term_id < deleted_postings_.size(); ++term_id) {
+        if (deleted_postings_[term_id] > 0) {
+            term_ids.push_back(term_id);
+        }
+    }
+    // Списки разных слов независимы и чистятся параллельно, каждый — одним проходом
+    for_each(execution::par, term_ids.begin(), term_ids.end(), [this](uint32_t term_id) {
+        GetMutablePostings(term_id).EraseSlots(deleted_slot_list_);
+    });
+    fill(deleted_postings_.begin(), deleted_postings_.end(), 0);
+    free_slots_.insert(free_slots_.end(), deleted_slot_list_.begin(), deleted_slot_list_.end());
+    deleted_slot_list_.clear();
+    deleted_slots_.Clear();
+}
+
+void SearchServer::SetCompactionThreshold(double threshold) {
+    if (!(threshold > 0.0 && threshold <= 1.0)) {
+        throw invalid_argument("Порог уплотнения должен быть в (0, 1]"s);
+    }
+    compaction_threshold_ = threshold;
+    CompactIfNeeded();
+}
+
+size_t SearchServer::GetDeletedDocumentCount() const {
+    return deleted_slot_list_.size();
+}
+
+size_t SearchServer::GetLiveDocumentFreq(uint32_t term_id) const {
+    const size_t size = word_to_document_freqs_[term_id].size();
+    return term_id < deleted_postings_.size() ? size - deleted_postings_[term_id] : size;
+}
+
+PostingList& SearchServer::GetMutablePostings(uint32_t term_id) {
+    PostingList& postings = word_to_document_freqs_[term_id];
+    postings.Decompress(document_lengths_.data());
+    return postings;
+}
+
+void SearchServer::AddDocumentsFrom(const SearchServer& other, const set<int>& skipped_ids) {
+    if (log_) {
+        throw logic_error("Перенос документов из другого индекса не записывается в журнал"s);
+    }
+    vector<uint32_t> other_to_this(other.terms_.size(), TermDictionary::NO_TERM);
+    for (uint32_t other_slot = 0; other_slot < other.documents_.size(); ++other_slot) {
+        const DocumentData& document_data = other.documents_[other_slot];
+        const auto it = other.document_to_slot_.find(document_data.id);
+        if (it == other.document_to_slot_.end() || it->second != other_slot || skipped_ids.count(document_data.id) > 0) {
+            continue;
+        }
+        if (document_to_slot_.count(document_data.id) > 0) {
+            throw invalid_argument("Документ с таким id уже существует."s);
+        }
+        const ForwardIndex::Entries other_words = other.forward_index_.Get(other_slot);
+        vector<TermFreq> word_freqs;
+        word_freqs.reserve(other_words.size);
+        for (size_t i = 0; i < other_words.size; ++i) {
+            uint32_t& term_id = other_to_this[other_words.term_ids[i]];
+            if (term_id == TermDictionary::NO_TERM) {
+                term_id = terms_.Intern(other.terms_.GetTerm(other_words.term_ids[i]));
+            }
+            word_freqs.push_back({term_id, other_words.term_freqs[i]});
+        }
+        sort(word_freqs.begin(), word_freqs.end(), [](const TermFreq& lhs, const TermFreq& rhs) {
+            return lhs.term_id < rhs.term_id;
+        });
+        if (word_to_document_freqs_.size() < terms_.size()) {
+            word_to_document_freqs_.resize(terms_.size());
+        }
+        const uint32_t slot = AllocateSlot(document_data);
+        forward_index_.Set(slot, word_freqs);
+        for (const TermFreq& term_freq : word_freqs) {
+            GetMutablePostings(term_freq.term_id).Add(slot, term_freq.freq);
+        }
+        document_ids_.insert(document_data.id);
+        RegisterFingerprint(document_data.id);
+    }
+}
+
+void SearchServer::CompressIndex() {
+    Compact();
+    for (PostingList& postings : word_to_document_freqs_) {
+        postings.Compress(document_lengths_.data());
+    }
+}
+
+void SearchServer::BuildImpactIndex() {
+    ReleaseImpactIndex();
+    vector<uint32_t> term_ids;
+    for (uint32_t term_id = 0; term_id < word_to_document_freqs_.size(); ++term_id) {
+        if (GetLiveDocumentFreq(term_id) >= IMPACT_MIN_DOCUMENT_FREQ) {
+            term_ids.push_back(term_id);
+        }
+    }
+    vector<ImpactPostings> impact_postings(term_ids.size());
+    transform(execution::par, term_ids.begin(), term_ids.end(), impact_postings.begin(), [this](uint32_t term_id) {
+        TermScoring unit_scoring = ComputeTermScoring(Query{}, term_id);
+        unit_scoring.inverse_document_freq = 1.0;
+        return ImpactPostings(word_to_document_freqs_[term_id], unit_scoring, document_lengths_);
+    });
+    impact_postings_.reserve(term_ids.size());
+    for (size_t i = 0; i < term_ids.size(); ++i) {
+        impact_postings_.emplace(term_ids[i], move(impact_postings[i]));
+    }
+    has_impact_index_ = true;
+}
+
+void SearchServer::ReleaseImpactIndex() {
+    if (has_impact_index_) {
+        impact_postings_ = {};
+        has_impact_index_ = false;
+    }
+}
+
+bool SearchServer::FindKthRelevance(QueryScratch& scratch, size_t k, double& kth_relevance) {
+    if (k == 0 || scratch.candidates.size() < k) {
+        return false;
+    }
+    vector<double>& relevance = scratch.candidate_relevance;
+    relevance.clear();
+    for (const uint32_t slot : scratch.candidates) {
+        relevance.push_back(scratch.relevance[slot]);
+    }
+    nth_element(relevance.begin(), relevance.begin() + (k - 1), relevance.end(), greater<double>());
+    kth_relevance = relevance[k - 1];
+    return true;
+}
+
+void SearchServer::Save(const string& path) const {
+    SnapshotWriter writer(path);
+    writer.WriteStrings(stop_words_);
+    writer.WriteArray(vector<uint64_t>{log_sequence_number_});
+    terms_.Save(writer);
+
+    // Вхождения удалённых документов не записываются, а их слоты сохраняются свободными
+    vector<uint64_t> posting_offsets{0};
+    vector<double> max_term_freqs;
+    for (uint32_t term_id = 0; term_id < word_to_document_freqs_.size(); ++term_id) {
+        posting_offsets.push_back(posting_offsets.back() + GetLiveDocumentFreq(term_id));
+        max_term_freqs.push_back(word_to_document_freqs_[term_id].GetMaxTermFreq());
+    }
+    writer.WriteArray(posting_offsets);
+    writer.WriteArray(max_term_freqs);
+    const auto append_live = [this, &writer](const auto* values, const uint32_t* slots, size_t count) {
+        if (deleted_slot_list_.empty()) {
+            writer.Append(values, count);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!IsDeleted(slots[i])) {
+                writer.Append(values + i, 1);
+            }
+        }
+    };
+    writer.BeginArray<uint32_t>(posting_offsets.back());
+    for (const PostingList& postings : word_to_document_freqs_) {
+        postings.ForEachSlotBlock([&append_live](const uint32_t* slots, size_t count) {
+            append_live(slots, slots, count);
+        });
+    }
+    writer.EndArray();
+    writer.BeginArray<double>(posting_offsets.back());
+    for (const PostingList& postings : word_to_document_freqs_) {
+        postings.ForEachBlock(document_lengths_.data(), [&append_live](const uint32_t* slots, const double* term_freqs, size_t count) {
+            append_live(term_freqs, slots, count);
+        });
+    }
+    writer.EndArray();
+
+    writer.WriteArray(documents_);
+    vector<uint32_t> free_slots = free_slots_;
+    free_slots.insert(free_slots.end(), deleted_slot_list_.begin(), deleted_slot_list_.end());
+    writer.WriteArray(free_slots);
+
+    // У свободных слотов слов нет
+    vector<bool> is_free(documents_.size());
+    for (const uint32_t slot : free_slots) {
+        is_free[slot] = true;
+    }
+    vector<uint64_t> word_offsets{0};
+    for (uint32_t slot = 0; slot < documents_.size(); ++slot) {
+        word_offsets.push_back(word_offsets.back() + (is_free[slot] ? 0 : forward_index_.Get(slot).size));
+    }
+    writer.WriteArray(word_offsets);
+    writer.BeginArray<uint32_t>(word_offsets.back());
+    for (uint32_t slot = 0; slot < documents_.size(); ++slot) {
+        if (!is_free[slot]) {
+            const ForwardIndex::Entries words = forward_index_.Get(slot);
+            writer.Append(words.term_ids, words.size);
+        }
+    }
+    writer.EndArray();
+    writer.BeginArray<double>(word_offsets.back());
+    for (uint32_t slot = 0; slot < documents_.size(); ++slot) {
+        if (!is_free[slot]) {
+            const ForwardIndex::Entries words = forward_index_.Get(slot);
+            writer.Append(words.term_freqs, words.size);
+        }
+    }
+    writer.EndArray();
+    writer.Finish();
+}
+
+SearchServer SearchServer::Load(const string& path) {
+    const auto file = make_shared<const MappedFile>(path);
+    SnapshotReader reader(*file);
+    const StringTable stop_words_table = reader.ReadStrings();
+    vector<string_view> stop_words(stop_words_table.count);
+    for (size_t i = 0; i < stop_words.size(); ++i) {
+        stop_words[i] = stop_words_table[i];
+    }
+    SearchServer search_server(stop_words);
+    const auto log_sequence_number = reader.ReadArray<uint64_t>();
+    if (log_sequence_number.size != 1) {
+        throw runtime_error("Снимок повреждён: нет номера записи журнала"s);
+    }
+    search_server.log_sequence_number_ = log_sequence_number.data[0];
+    search_server.snapshot_ = file;
+    search_server.terms_.Attach(reader);
+
+    const auto corrupted = [](const char* what) {
+        return runtime_error("Снимок повреждён: "s + what);
+    };
+    const size_t term_count = search_server.terms_.size();
+    const auto posting_offsets = reader.ReadArray<uint64_t>();
+    const auto max_term_freqs = reader.ReadArray<double>();
+    const auto slots = reader.ReadArray<uint32_t>();
+    const auto term_freqs = reader.ReadArray<double>();
+    if (posting_offsets.size != term_count + 1 || max_term_freqs.size != term_count
+        || posting_offsets.data[0] != 0 || posting_offsets.data[term_count] != slots.size || term_freqs.size != slots.size) {
+        throw corrupted("неверные списки вхождений");
+    }
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        if (posting_offsets.data[term_id + 1] < posting_offsets.data[term_id]) {
+            throw corrupted("неверные списки вхождений");
+        }
+    }
+
+    const auto documents = reader.ReadArray<DocumentData>();
+    const auto free_slots = reader.ReadArray<uint32_t>();
+    search_server.documents_.assign(documents.data, documents.data + documents.size);
+    search_server.free_slots_.assign(free_slots.data, free_slots.data + free_slots.size);
+    vector<bool> is_free(documents.size);
+    for (const uint32_t slot : search_server.free_slots_) {
+        if (slot >= documents.size) {
+            throw corrupted("неверный свободный слот");
+        }
+        if (is_free[slot]) {
+            throw corrupted("повторяющийся свободный слот");
+        }
+        is_free[slot] = true;
+    }
+    // Списки читаются из файла как есть, поэтому каждый должен быть строго возрастающим
+    // и ссылаться только на занятые слоты
+    search_server.word_to_document_freqs_.resize(term_count);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        const uint64_t begin = posting_offsets.data[term_id];
+        const uint64_t end = posting_offsets.data[term_id + 1];
+        for (uint64_t i = begin; i < end; ++i) {
+            if (slots.data[i] >= documents.size || is_free[slots.data[i]] || (i > begin && slots.data[i] <= slots.data[i - 1])) {
+                throw corrupted("неверный слот в списке вхождений");
+            }
+        }
+        search_server.word_to_document_freqs_[term_id].AttachMapped(slots.data + begin, term_freqs.data + begin, end - begin, max_term_freqs.data[term_id]);
+    }
+    search_server.document_lengths_.resize(documents.size);
+    search_server.document_ratings_.resize(documents.size);
+    search_server.document_id_column_.resize(documents.size);
+    for (uint32_t slot = 0; slot < documents.size; ++slot) {
+        search_server.document_lengths_[slot] = documents.data[slot].word_count;
+        search_server.document_ratings_[slot] = documents.data[slot].rating;
+        search_server.document_id_column_[slot] = documents.data[slot].id;
+        if (!is_free[slot]) {
+            const size_t status = static_cast<size_t>(documents.data[slot].status);
+            if (status < STATUS_COUNT) {
+                search_server.status_slots_[status].Set(slot);
+            }
+            if (!search_server.document_to_slot_.emplace(documents.data[slot].id, slot).second) {
+                throw corrupted("повторяющийся id документа");
+            }
+            search_server.document_ids_.insert(documents.data[slot].id);
+            search_server.CountDocumentLength(slot);
+        }
+    }
+
+    const auto word_offsets = reader.ReadArray<uint64_t>();
+    const auto word_term_ids = reader.ReadArray<uint32_t>();
+    const auto word_term_freqs = reader.ReadArray<double>();
+    if (word_offsets.size != documents.size + 1 || word_offsets.data[0] != 0 || word_offsets.data[documents.size] != word_term_ids.size
+        || word_term_freqs.size != word_term_ids.size) {
+        throw corrupted("неверные слова документов");
+    }
+    for (size_t slot = 0; slot < documents.size; ++slot) {
+        const uint64_t begin = word_offsets.data[slot];
+        const uint64_t end = word_offsets.data[slot + 1];
+        if (end < begin) {
+            throw corrupted("неверные слова документов");
+        }
+        for (uint64_t i = begin; i < end; ++i) {
+            if (word_term_ids.data[i] >= term_count || (i > begin && word_term_ids.data[i] <= word_term_ids.data[i - 1])) {
+                throw corrupted("неверный id слова в словах документа");
+            }
+        }
     }
-    words_to_id_.erase(document_id);
+    reader.Finish();
+    search_server.forward_index_.AttachMapped(word_offsets.data, word_term_ids.data, word_term_freqs.data, documents.size);
+    return search_server;
+}
+
+void SearchServer::OpenWriteAheadLog(const string& path) {
+    OpenWriteAheadLog(execution::seq, path);
+}
+
+void SearchServer::SyncWriteAheadLog() {
+    if (log_) {
+        log_->Sync();
+    }
+}
+
+ForwardIndex::Entries SearchServer::GetDocumentWords(int document_id) const {
+    const auto slot_it = document_to_slot_.find(document_id);
+    if (slot_it == document_to_slot_.end()) {
+        throw out_of_range("There is no document with such id");
+    }
+    return forward_index_.Get(slot_it->second);
 }
 
 MatchedDocuments SearchServer::MatchDocument(const string_view& raw_query, int document_id) const {
@@ -84,62 +689,84 @@ MatchedDocuments SearchServer::MatchDocument(const string_view& raw_query, int d
 }
 
 MatchedDocuments SearchServer::MatchDocument(execution::sequenced_policy policy, const string_view& raw_query, int document_id) const {
-    if (!document_ids_.count(document_id)) {
+    const auto slot_it = document_to_slot_.find(document_id);
+    if (slot_it == document_to_slot_.end()) {
         throw std::out_of_range("There is no document with such id");
     }
+    const uint32_t slot = slot_it->second;
     if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("Invalid query");
     }
-    const auto query = ParseQuery(raw_query);
+    Query query;
+    ParseQuery(raw_query, query);
 
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&] (auto &word) {
-        return word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(std::string{word}).count(document_id);})) {
-        return { std::vector<std::string_view> {}, documents_.at(document_id).status };
+    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&] (const uint32_t term_id) {
+        return word_to_document_freqs_[term_id].Contains(slot);})) {
+        return { std::vector<std::string_view> {}, documents_[slot].status };
+    }
+    // Документ без обязательного слова запросу не соответствует
+    if (query.has_missing_required_word || !all_of(policy, query.required_words.begin(), query.required_words.end(), [&] (const uint32_t term_id) {
+        return word_to_document_freqs_[term_id].Contains(slot);})) {
+        return { std::vector<std::string_view> {}, documents_[slot].status };
     }
 
-    std::vector<std::string_view> matched_words(query.plus_words.size());
+    std::vector<uint32_t> matched_terms(query.plus_words.size());
 
-    if (!matched_words.empty()) {
-        auto new_end = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(),matched_words.begin(),
-                                    [&](const auto& plus_word) {
-                                        return word_to_document_freqs_.at(std::string{plus_word}).count(document_id);
+    if (!matched_terms.empty()) {
+        auto new_end = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_terms.begin(),
+                                    [&](const uint32_t term_id) {
+                                        return word_to_document_freqs_[term_id].Contains(slot);
                                     });
-        matched_words.resize(distance(matched_words.begin(), new_end));
-
+        std::vector<std::string_view> matched_words;
+        matched_words.reserve(distance(matched_terms.begin(), new_end));
+        for (auto it = matched_terms.begin(); it != new_end; ++it) {
+            matched_words.push_back(terms_.GetTerm(*it));
+        }
 
-        return { matched_words, documents_.at(document_id).status };
+        return { matched_words, documents_[slot].status };
     }
-    return {std::vector<std::string_view> {}, documents_.at(document_id).status};
+    return {std::vector<std::string_view> {}, documents_[slot].status};
 }
 
 MatchedDocuments SearchServer::MatchDocument(execution::parallel_policy policy, const std::string_view& raw_query, int document_id) const {
-    if (!document_ids_.count(document_id)) {
+    const auto slot_it = document_to_slot_.find(document_id);
+    if (slot_it == document_to_slot_.end()) {
         throw std::out_of_range("There is no document with such id");
     }
+    const uint32_t slot = slot_it->second;
     if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("Invalid query");
     }
-    const auto query = ParseQuery(raw_query, true);
+    Query query;
+    ParseQuery(raw_query, query);
 
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&] (auto &word) {
-        return word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(std::string{word}).count(document_id);})) {
-        return { std::vector<std::string_view> {}, documents_.at(document_id).status };
+    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&] (const uint32_t term_id) {
+        return word_to_document_freqs_[term_id].Contains(slot);})) {
+        return { std::vector<std::string_view> {}, documents_[slot].status };
+    }
+    // Документ без обязательного слова запросу не соответствует
+    if (query.has_missing_required_word || !all_of(policy, query.required_words.begin(), query.required_words.end(), [&] (const uint32_t term_id) {
+        return word_to_document_freqs_[term_id].Contains(slot);})) {
+        return { std::vector<std::string_view> {}, documents_[slot].status };
     }
 
-    std::vector<std::string_view> matched_words(query.plus_words.size());
+    std::vector<uint32_t> matched_terms(query.plus_words.size());
 
-    if (!matched_words.empty()) {
-        auto new_end = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(),matched_words.begin(),
-                                    [&](const auto& plus_word) {
-                                        return word_to_document_freqs_.at(std::string{plus_word}).count(document_id);
+    if (!matched_terms.empty()) {
+        auto new_end = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_terms.begin(),
+                                    [&](const uint32_t term_id) {
+                                        return word_to_document_freqs_[term_id].Contains(slot);
                                     });
-        matched_words.resize(distance(matched_words.begin(), new_end));
-
-        set<string_view> no_duplications(matched_words.begin(), matched_words.end());
+        // Слова запроса уже без повторов и в порядке строк
+        std::vector<std::string_view> matched_words;
+        matched_words.reserve(distance(matched_terms.begin(), new_end));
+        for (auto it = matched_terms.begin(); it != new_end; ++it) {
+            matched_words.push_back(terms_.GetTerm(*it));
+        }
 
-        return { vector<string_view> { no_duplications.begin(), no_duplications.end() }, documents_.at(document_id).status };
+        return { matched_words, documents_[slot].status };
     }
-    return {std::vector<std::string_view> {}, documents_.at(document_id).status};
+    return {std::vector<std::string_view> {}, documents_[slot].status};
 }
 
 bool SearchServer::IsStopWord(const string_view& word) const {
@@ -147,20 +774,25 @@ bool SearchServer::IsStopWord(const string_view& word) const {
 }
 
 bool SearchServer::IsValidWord(const std::string_view& word) {
-    return std::none_of(word.begin(), word.end(),
-                        [](char c) { return c >= '\0' && c < ' '; });
+    return IsValidText(word);
 }
 
 vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view& text) const {
     vector<string_view> words;
-    for (const string_view& word : SplitIntoWords(text)) {
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
-    }
+    TokenizeText(text, words);
+    RemoveStopWords(words);
     return words;
 }
 
+void SearchServer::RemoveStopWords(vector<string_view>& words) const {
+    if (stop_words_.empty()) {
+        return;
+    }
+    words.erase(remove_if(words.begin(), words.end(), [this](const string_view word) {
+        return IsStopWord(word);
+    }), words.end());
+}
+
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -171,46 +803,113 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 }
 
 SearchServer::QueryWord
-SearchServer::ParseQueryWord(std::string_view& text) const {
-    if (text.empty()) {
+SearchServer::ParseQueryWord(std::string_view word) const {
+    if (word.empty()) {
         throw std::invalid_argument("Empty text");
     }
     bool is_minus = false;
-    if (text.front() == '-') {
+    bool is_required = false;
+    if (word.front() == '-') {
         is_minus = true;
-        text = text.substr(1);
+        word.remove_prefix(1);
+    } else if (word.front() == '+') {
+        is_required = true;
+        word.remove_prefix(1);
     }
-    if (text.empty() || text.front() == '-' || !IsValidWord(text)) {
+    if (word.empty() || word.front() == '-' || (is_required && word.front() == '+') || !IsValidWord(word)) {
         throw std::invalid_argument("Parse query error");
     }
 
-    return QueryWord{text, is_minus, IsStopWord(text)};
+    return QueryWord{word, is_minus, is_required, IsStopWord(word)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const string_view& text, bool par) const {
-    Query result;
-    for (const string_view& word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(const_cast<string_view &>(word));
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            } else {
-                result.plus_words.push_back(query_word.data);
+void SearchServer::ParseQuery(string_view text, Query& result) const {
+    result.plus_words.clear();
+    result.minus_words.clear();
+    result.required_words.clear();
+    result.has_missing_required_word = false;
+    ForEachWord(text, [&](string_view word) {
+        const auto query_word = ParseQueryWord(word);
+        if (query_word.is_stop) {
+            return;
+        }
+        const uint32_t term_id = terms_.Find(query_word.data);
+        if (term_id == TermDictionary::NO_TERM) {
+            result.has_missing_required_word |= query_word.is_required;
+            return;
+        }
+        if (query_word.is_minus) {
+            result.minus_words.push_back(term_id);
+        } else {
+            result.plus_words.push_back(term_id);
+            if (query_word.is_required) {
+                result.required_words.push_back(term_id);
             }
         }
+    });
+    // Порядок слов как у строк, чтобы релевантность суммировалась в том же порядке
+    const auto by_word = [this](uint32_t lhs, uint32_t rhs) {
+        return terms_.GetTerm(lhs) < terms_.GetTerm(rhs);
+    };
+    sort(result.plus_words.begin(), result.plus_words.end(), by_word);
+    result.plus_words.erase(unique(result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
+
+    sort(result.minus_words.begin(), result.minus_words.end(), by_word);
+    result.minus_words.erase(unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
+
+    sort(result.required_words.begin(), result.required_words.end(), by_word);
+    result.required_words.erase(unique(result.required_words.begin(), result.required_words.end()), result.required_words.end());
+}
+
+bool SearchServer::IsCancelled(const Query& query) {
+    return query.cancellation != nullptr && query.cancellation->IsCancelled();
+}
+
+void SearchServer::CheckCancellation(const Query& query) {
+    if (IsCancelled(query)) {
+        throw QueryCancelledError();
     }
-    if (!par) {
-        sort(result.plus_words.begin(), result.plus_words.end());
-        result.plus_words.erase(unique(result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
+}
 
-        sort(result.minus_words.begin(), result.minus_words.end());
-        result.minus_words.erase(unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
+bool SearchServer::IsCancelled(const Query& query, size_t posting_count, size_t& unchecked_postings) {
+    unchecked_postings += posting_count;
+    if (unchecked_postings < CANCELLATION_CHECK_INTERVAL) {
+        return false;
+    }
+    unchecked_postings = 0;
+    return IsCancelled(query);
+}
 
+void SearchServer::CheckCancellation(const Query& query, size_t posting_count, size_t& unchecked_postings) {
+    if (IsCancelled(query, posting_count, unchecked_postings)) {
+        throw QueryCancelledError();
     }
-    return result;
 }
 
 // Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view& word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(std::string{word}).size());
-}
\ No newline at end of file
+double SearchServer::ComputeWordInverseDocumentFreq(const Query& query, uint32_t term_id) const {
+    if (query.statistics != nullptr) {
+        const int document_freq = query.statistics->document_freq(terms_.GetTerm(term_id));
+        // Все документы со словом удалены из коллекции, но ещё не из этой её части
+        if (document_freq == 0) {
+            return 0.0;
+        }
+        return log(query.statistics->document_count * 1.0 / document_freq);
+    }
+    return log(GetDocumentCount() * 1.0 / GetLiveDocumentFreq(term_id));
+}
+
+TermScoring SearchServer::ComputeTermScoring(const Query& query, uint32_t term_id) const {
+    if (ranking_model_ == RankingModel::TF_IDF) {
+        return MakeTfIdfScoring(ComputeWordInverseDocumentFreq(query, term_id));
+    }
+    double document_count = GetDocumentCount();
+    double document_freq = GetLiveDocumentFreq(term_id);
+    if (query.statistics != nullptr) {
+        document_count = query.statistics->document_count;
+        document_freq = query.statistics->document_freq(terms_.GetTerm(term_id));
+    }
+    const double inverse_document_freq = document_freq == 0 ? 0.0 : log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+    const double average_document_length = document_to_slot_.empty() ? 1.0 : total_document_length_ * 1.0 / document_to_slot_.size();
+    return MakeBm25Scoring(inverse_document_freq, bm25_parameters_, average_document_length);
+}
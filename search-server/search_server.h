@@ -8,18 +8,64 @@
 #include <map>
 #include <string>
 #include <algorithm>
+#include <array>
+#include <numeric>
+#include <exception>
 #include <execution>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include "document.h"
+#include "document_predicates.h"
+#include "document_fingerprint.h"
+#include "forward_index.h"
+#include "impact_postings.h"
 #include "string_processing.h"
+#include "text_scanner.h"
 #include "read_input_functions.h"
+#include "cancellation.h"
 #include "concurrent_map.h"
+#include "posting_list.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+#include "query_cache.h"
+#include "query_scratch.h"
+#include "scoring_kernel.h"
+#include "small_vector.h"
+#include "snapshot.h"
+#include "write_ahead_log.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double SET_PRECISION = 1e-6;
 
 using MatchedDocuments = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
+// Статистика всей коллекции для IDF, когда индекс хранит лишь её часть:
+// число документов и число документов, содержащих слово
+struct CollectionStatistics {
+    int document_count = 0;
+    std::function<int(std::string_view)> document_freq;
+};
+
+// Документ для пакетного добавления; текст должен жить до конца вызова AddDocuments
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Что делают AddDocument и AddDocuments с документом, набор слов которого совпадает с уже добавленным
+enum class DuplicateMode {
+    IGNORE,
+    // Документ добавляется, а его id попадает в GetFlaggedDuplicates
+    FLAG,
+    // AddDocument бросает invalid_argument, AddDocuments пропускает документ с этой ошибкой
+    REJECT,
+};
+
 class SearchServer {
 public:
     template <typename StringContainer>
@@ -29,78 +75,339 @@ public:
 
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Добавляет пакет документов так же, как последовательные вызовы AddDocument, но разбивает
+    // тексты на слова и строит части индекса параллельно. Документ, который AddDocument отверг бы,
+    // пропускается: в результате на его месте исключение, у добавленных документов — nullptr.
+    // При включённой проверке дубликатов параллельно только разбиение на слова
+    template <typename ExecutionPolicy>
+    std::vector<std::exception_ptr> AddDocuments(ExecutionPolicy policy, const std::vector<NewDocument>& documents);
+    std::vector<std::exception_ptr> AddDocuments(const std::vector<NewDocument>& documents);
+
+    // top_count — сколько лучших документов вернуть. Слово запроса с префиксом «+» обязательно:
+    // подходят только документы со всеми такими словами, а остальные плюс-слова лишь добавляют релевантность
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const {
-        return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_count);
     }
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view& raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view& raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const std::string_view& raw_query, DocumentStatus status, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view& raw_query) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Поиск в индексе, который хранит часть коллекции: IDF слов считается по statistics
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count, const CollectionStatistics& statistics) const;
+
+    // Поиск, который бросает QueryCancelledError, как только cancellation отменён или истёк его срок
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count, const CancellationToken& cancellation) const;
+
+    // Модель релевантности для всех видов поиска, по умолчанию TF-IDF. Средняя длина документа
+    // для BM25 считается по этому индексу, даже если IDF берётся из CollectionStatistics
+    void SetRankingModel(RankingModel model, const Bm25Parameters& parameters = {});
+
+    // Включает кеш результатов поиска по статусу на capacity запросов, 0 — выключает.
+    // Поиск с предикатом и с параллельной политикой через кеш не идёт
+    void SetQueryCacheCapacity(size_t capacity);
+    QueryCacheCounters GetQueryCacheCounters() const;
 
     int GetDocumentCount() const;
+    bool HasDocument(int document_id) const;
+
+    // Отпечаток и сигнатура MinHash набора слов документа; зависят от id слов этого индекса
+    DocumentFingerprint GetDocumentFingerprint(int document_id) const;
+    MinHashSignature GetDocumentMinHash(int document_id) const;
+
+    // Включает проверку дубликатов при AddDocument и AddDocuments. Документы, добавленные другими
+    // способами, не проверяются, но их отпечатки учитываются при проверке следующих
+    void SetDuplicateMode(DuplicateMode mode);
+    const std::set<int>& GetFlaggedDuplicates() const;
+    // Число документов, содержащих слово
+    int GetDocumentFreq(std::string_view word) const;
 
     std::set<int>::const_iterator begin() const;
     std::set<int>::const_iterator end() const;
-    const std::map<std::string_view, double, std::less<>> GetWordFrequencies(int document_id) const;
+    // Слова документа и их частоты в порядке id слов, без копирования; пусто, если документа нет.
+    // Представление действительно, пока индекс не изменён
+    WordFrequencies GetWordFrequencies(int document_id) const;
+    // Удаление только помечает слот документа: документ сразу пропадает из выдачи, GetDocumentCount и IDF,
+    // а его вхождения убираются из списков при уплотнении. RemoveDocuments пропускает отсутствующие id
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy policy, int document_id);
     void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Убирает из списков вхождения удалённых документов и освобождает их слоты. Вызывается сам,
+    // когда удалённые документы составляют больше threshold всех занятых слотов; threshold = 1 — только явно
+    static constexpr double DEFAULT_COMPACTION_THRESHOLD = 0.25;
+    void Compact();
+    void SetCompactionThreshold(double threshold);
+    size_t GetDeletedDocumentCount() const;
+
+    // Добавляет документы другого индекса с теми же стоп-словами, кроме skipped_ids,
+    // сохраняя частоты слов, рейтинги и статусы. В журнал не записывается
+    void AddDocumentsFrom(const SearchServer& other, const std::set<int>& skipped_ids);
+
+    // Сжимает списки вхождений всех слов. Выдача не меняется; изменённые после этого
+    // списки хранятся несжатыми до следующего вызова
+    void CompressIndex();
+
+    // Строит для слов, которые встречаются не меньше чем в IMPACT_MIN_DOCUMENT_FREQ документах,
+    // копии списков вхождений, упорядоченные по вкладу. Пока индекс не изменится, последовательный
+    // поиск лучших документов проходит уровни вклада от больших к меньшим и останавливается, как только
+    // лучшие top_count документов уже не могут смениться. Выдача не меняется. Любое добавление
+    // или удаление документа и смена модели релевантности освобождают эти списки до следующего вызова
+    static constexpr size_t IMPACT_MIN_DOCUMENT_FREQ = 1024;
+    void BuildImpactIndex();
+
+    // Сохраняет индекс в файл снимка. Сжатые списки вхождений записываются распакованными
+    void Save(const std::string& path) const;
+    // Открывает снимок, отображая его в память: списки вхождений, словарь и слова документов
+    // читаются прямо из файла, заново строятся только таблицы id документов
+    static SearchServer Load(const std::string& path);
+
+    // Применяет к индексу (например, загруженному из снимка) изменения из журнала, ещё не учтённые в нём,
+    // и дальше записывает в журнал каждое добавление и удаление документа до того, как выполнить его.
+    // Изменение возвращает управление, только когда его запись на диске; пакетные AddDocuments
+    // и RemoveDocuments фиксируют все свои записи одним fsync. После ошибки записи журнала
+    // индекс может содержать неподтверждённые изменения, и его нужно загрузить заново
+    template <typename ExecutionPolicy>
+    void OpenWriteAheadLog(ExecutionPolicy policy, const std::string& path);
+    void OpenWriteAheadLog(const std::string& path);
+    // Дожидается, пока все изменения индекса окажутся в журнале на диске
+    void SyncWriteAheadLog();
 
     MatchedDocuments MatchDocument(const std::string_view& raw_query, int document_id) const;
     MatchedDocuments MatchDocument(std::execution::sequenced_policy policy, const std::string_view& raw_query, int document_id) const;
     MatchedDocuments MatchDocument(std::execution::parallel_policy policy, const std::string_view& raw_query, int document_id) const;
 private:
     struct DocumentData {
+        int id;
         int rating;
         DocumentStatus status;
+        uint32_t word_count;
+    };
+    struct TermFreq {
+        uint32_t term_id;
+        double freq;
     };
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    TermDictionary terms_;
+    // Индексируются id слова из terms_, в списках хранятся слоты документов
+    std::vector<PostingList> word_to_document_freqs_;
+    // Индексируются слотом — плотным внутренним номером документа; слоты удалённых документов переиспользуются
+    std::vector<DocumentData> documents_;
+    std::unordered_map<int, uint32_t> document_to_slot_;
+    std::vector<uint32_t> free_slots_;
     std::set<int> document_ids_;
-    std::map<int, std::map<std::string_view, double, std::less<>>> words_to_id_;
+    // Индексируется слотом; слова документа отсортированы по id слова
+    ForwardIndex forward_index_;
+
+    // Слоты удалённых документов, вхождения которых ещё лежат в списках
+    SlotBitset deleted_slots_;
+    std::vector<uint32_t> deleted_slot_list_;
+    // Индексируется id слова: сколько вхождений в его списке принадлежат удалённым документам
+    std::vector<uint32_t> deleted_postings_;
+    double compaction_threshold_ = DEFAULT_COMPACTION_THRESHOLD;
+
+    // Слоты документов с каждым статусом; у освобождённого слота бит статуса остаётся до его переиспользования
+    static constexpr size_t STATUS_COUNT = 4;
+    std::array<SlotBitset, STATUS_COUNT> status_slots_;
+    // Рейтинги и id документов по слотам — плотные колонки для RatingAtLeast и IdInRange:
+    // за одну строку кэша проверяются 16 документов, а не 4, как по documents_
+    std::vector<int> document_ratings_;
+    std::vector<int> document_id_column_;
+
+    RankingModel ranking_model_ = RankingModel::TF_IDF;
+    Bm25Parameters bm25_parameters_;
+    // Длины документов по слотам — плотная колонка для ядра оценки, — их сумма по неудалённым документам и максимум
+    std::vector<uint32_t> document_lengths_;
+    uint64_t total_document_length_ = 0;
+    uint32_t max_document_length_ = 0;
+
+    // Списки по вкладу, построенные BuildImpactIndex; у остальных слов уровень один — весь список
+    std::unordered_map<uint32_t, ImpactPostings> impact_postings_;
+    bool has_impact_index_ = false;
+    void ReleaseImpactIndex();
+
+    // Загруженный снимок: списки вхождений, словарь и прямой индекс могут ссылаться на его память
+    std::shared_ptr<const MappedFile> snapshot_;
+
+    // Слова документа; бросает out_of_range, если документа нет
+    ForwardIndex::Entries GetDocumentWords(int document_id) const;
+
+    DuplicateMode duplicate_mode_ = DuplicateMode::IGNORE;
+    // Число документов индекса с каждым отпечатком; ведётся, только если проверка дубликатов включена
+    std::unordered_map<DocumentFingerprint, int, DocumentFingerprintHasher> fingerprint_counts_;
+    std::set<int> flagged_duplicates_;
+
+    // Учитывают отпечаток документа, пока его слова есть в индексе
+    void RegisterFingerprint(int document_id);
+    void UnregisterFingerprint(int document_id);
+    // Отпечаток нового документа, если все его слова уже есть в словаре; иначе дубликатов у него нет
+    bool FindNewDocumentFingerprint(const std::vector<std::string_view>& words, DocumentFingerprint& fingerprint) const;
+    // Бросает invalid_argument, если дубликат нужно отвергнуть; true — документ дублирует уже добавленный
+    bool CheckDuplicate(const std::vector<std::string_view>& words) const;
+    // Пакет с проверкой дубликатов: она зависит от id слов предыдущих документов пакета,
+    // поэтому документы добавляются по порядку, как AddDocument, а журнал фиксируется один раз
+    template <typename ExecutionPolicy>
+    std::vector<std::exception_ptr> AddDocumentsCheckingDuplicates(ExecutionPolicy policy, const std::vector<NewDocument>& documents);
+
+    std::unique_ptr<QueryResultCache> query_cache_;
+    // Меняется при каждом добавлении и удалении документа; результаты в кеше помнят поколение
+    uint64_t generation_ = 0;
+
+    std::unique_ptr<WriteAheadLog> log_;
+    // Номер последней записи журнала, учтённой в индексе; сохраняется в снимке
+    uint64_t log_sequence_number_ = 0;
+
+    void CheckNewDocument(int document_id, bool is_valid_text) const;
+    // Добавляет проверенный документ, уже разбитый на слова
+    void AddDocumentWords(int document_id, const std::vector<std::string_view>& words, DocumentStatus status, const std::vector<int>& ratings);
+    // Занимает свободный слот или заводит новый и связывает его с id документа
+    uint32_t AllocateSlot(const DocumentData& document_data);
+    // Учитывает длину документа в слоте в сумме и максимуме длин
+    void CountDocumentLength(uint32_t slot);
+    // Убирает документ из таблиц id и помечает его слот удалённым
+    void MarkDeleted(int document_id, uint32_t slot);
+    void CompactIfNeeded();
+
+    bool IsDeleted(uint32_t slot) const {
+        return !deleted_slot_list_.empty() && deleted_slots_.Test(slot);
+    }
+    // Число неудалённых документов в списке слова
+    size_t GetLiveDocumentFreq(uint32_t term_id) const;
+    // Список слова для изменения; сжатый список сначала распаковывается
+    PostingList& GetMutablePostings(uint32_t term_id);
+    // Курсор по списку; блоки сжатого списка распаковываются в буферы scratch
+    PostingCursor MakeCursor(const PostingList& postings, QueryScratch& scratch) const {
+        return PostingCursor(postings, document_lengths_.data(), postings.IsCompressed() ? scratch.AcquireDecodedBlock() : nullptr);
+    }
+
+    // Проверка предиката для документа в слоте: StatusIs — по status_slots_, RatingAtLeast и IdInRange —
+    // по колонкам рейтингов и id, остальные предикаты вызываются с полями документа и встраиваются компилятором
+    template <typename DocumentPredicate>
+    bool Accepts(const DocumentPredicate& document_predicate, uint32_t slot) const {
+        const DocumentData& document_data = documents_[slot];
+        return document_predicate(document_data.id, document_data.status, document_data.rating);
+    }
+    bool Accepts(const StatusIs& predicate, uint32_t slot) const {
+        const size_t status = static_cast<size_t>(predicate.status);
+        return status < STATUS_COUNT ? status_slots_[status].Test(slot) : documents_[slot].status == predicate.status;
+    }
+    bool Accepts(const RatingAtLeast& predicate, uint32_t slot) const {
+        return document_ratings_[slot] >= predicate.min_rating;
+    }
+    bool Accepts(const IdInRange& predicate, uint32_t slot) const {
+        const int document_id = document_id_column_[slot];
+        return (document_id >= predicate.first) & (document_id < predicate.last);
+    }
+    // Сортирует id слов документа и считает их частоты
+    static std::vector<TermFreq> ComputeTermFreqs(std::vector<uint32_t>& term_ids);
+
+    // Наименьшая часть пакета, которую AddDocuments разбирает в одном потоке
+    static constexpr size_t MIN_DOCUMENTS_PER_CHUNK = 256;
 
     bool IsStopWord(const std::string_view& word) const;
 
     static bool IsValidWord(const std::string_view& word);
 
     std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text) const;
+    void RemoveStopWords(std::vector<std::string_view>& words) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(std::string_view& text) const;
+    QueryWord ParseQueryWord(std::string_view word) const;
 
+    // Слова обычного запроса помещаются во внутренний буфер Query, и разбор не выделяет память
+    static constexpr size_t QUERY_INLINE_WORDS = 16;
+
+    // Слова запроса, уже сопоставленные с id словаря, без повторов и в порядке строк;
+    // слова, которых нет в индексе, отбрасываются
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        SmallVector<uint32_t, QUERY_INLINE_WORDS> plus_words;
+        SmallVector<uint32_t, QUERY_INLINE_WORDS> minus_words;
+        // Обязательные слова; каждое есть и в plus_words
+        SmallVector<uint32_t, QUERY_INLINE_WORDS> required_words;
+        // Обязательного слова нет в словаре — запросу не соответствует ни один документ
+        bool has_missing_required_word = false;
+        // Статистика всей коллекции, если индекс хранит лишь её часть
+        const CollectionStatistics* statistics = nullptr;
+        const CancellationToken* cancellation = nullptr;
     };
 
-    Query ParseQuery(const std::string_view& text, bool par = false) const;
+    // Разбирает запрос за один проход по тексту, сразу находя слова в словаре
+    void ParseQuery(std::string_view text, Query& result) const;
+    static std::string MakeQueryCacheKey(const Query& query, DocumentStatus status, size_t top_count);
+
+    // Отмена проверяется раз в CANCELLATION_CHECK_INTERVAL вхождений, чтобы не обращаться к часам на каждом
+    static constexpr size_t CANCELLATION_CHECK_INTERVAL = 1024;
+    static bool IsCancelled(const Query& query);
+    static void CheckCancellation(const Query& query);
+    // Для обхода пакетами: posting_count вхождений добавляются к unchecked_postings, и отмена
+    // проверяется, только когда их набралось CANCELLATION_CHECK_INTERVAL
+    static bool IsCancelled(const Query& query, size_t posting_count, size_t& unchecked_postings);
+    static void CheckCancellation(const Query& query, size_t posting_count, size_t& unchecked_postings);
 
     // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view& word) const;
+    double ComputeWordInverseDocumentFreq(const Query& query, uint32_t term_id) const;
+    TermScoring ComputeTermScoring(const Query& query, uint32_t term_id) const;
+
+    // Вхождения оцениваются ядром пачками до SCORING_BATCH_SIZE; callback(slots, scores, count)
+    static constexpr size_t SCORING_BATCH_SIZE = 256;
+    template <typename Callback>
+    void ScorePostingBatches(const PostingList& postings, const TermScoring& scoring, Callback callback) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const Query& query, DocumentPredicate document_predicate, size_t top_count) const;
 
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
 
+    // Обход документ за документом с отсечением MaxScore: документы, которые не могут попасть
+    // в top_count лучших, не досчитываются. Результат совпадает с FindAllDocuments + отбором лучших
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsPruned(const Query& query, DocumentPredicate document_predicate, size_t top_count) const;
+
+    // Обход уровень за уровнем по спискам BuildImpactIndex: вхождения накапливаются в порядке убывания
+    // оценки вклада, пока топ не отделится от остальных документов с запасом больше, чем могут добавить
+    // непройденные уровни. Релевантность попавших в топ досчитывается по прямому индексу в порядке запроса,
+    // поэтому результат совпадает с FindTopDocumentsPruned
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByImpact(const Query& query, DocumentPredicate document_predicate, size_t top_count) const;
+    // Наибольшее число слов запроса, при котором поиск идёт по уровням вклада
+    static constexpr size_t IMPACT_MAX_QUERY_WORDS = 64;
+    // k-я по величине накопленная релевантность кандидатов; false, если кандидатов меньше k
+    static bool FindKthRelevance(QueryScratch& scratch, size_t k, double& kth_relevance);
+
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(std::execution::parallel_policy policy, const Query& query, DocumentPredicate document_predicate) const;
+
+    static bool IsConjunctive(const Query& query) {
+        return !query.required_words.empty() || query.has_missing_required_word;
+    }
+    // Поиск с обязательными словами: их списки пересекаются, начиная с самого короткого, курсоры остальных
+    // обязательных списков догоняют ведущий экспоненциальным поиском, а частые слова сначала проверяются
+    // по битовым множествам слотов. Считается только релевантность документов пересечения;
+    // callback(slot, relevance) получает их по возрастанию слотов
+    template <typename DocumentPredicate, typename Callback>
+    void ForEachConjunctiveMatch(const Query& query, DocumentPredicate document_predicate, Callback callback) const;
 };
 
 template <typename StringContainer>
@@ -113,133 +420,733 @@ SearchServer::SearchServer(const StringContainer &stop_words)
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+    Query query;
+    ParseQuery(raw_query, query);
     if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("Содержимое запроса содержит недопустимые символы");
     }
-    auto matched_documents = FindAllDocuments(query, document_predicate);
+    return FindTopDocuments(query, document_predicate, top_count);
+}
 
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < SET_PRECISION) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count, const CollectionStatistics& statistics) const {
+    Query query;
+    ParseQuery(raw_query, query);
+    if (!IsValidWord(raw_query)) {
+        throw std::invalid_argument("Содержимое запроса содержит недопустимые символы");
     }
+    query.statistics = &statistics;
+    return FindTopDocuments(query, document_predicate, top_count);
+}
 
-    return matched_documents;
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count, const CancellationToken& cancellation) const {
+    Query query;
+    ParseQuery(raw_query, query);
+    if (!IsValidWord(raw_query)) {
+        throw std::invalid_argument("Содержимое запроса содержит недопустимые символы");
+    }
+    query.cancellation = &cancellation;
+    CheckCancellation(query);
+    return FindTopDocuments(query, document_predicate, top_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const Query& query, DocumentPredicate document_predicate, size_t top_count) const {
+    if (IsConjunctive(query)) {
+        TopDocuments top_documents(top_count);
+        ForEachConjunctiveMatch(query, document_predicate, [&](uint32_t slot, double relevance) {
+            top_documents.Push({documents_[slot].id, relevance, documents_[slot].rating});
+        });
+        return top_documents.Extract();
+    }
+    if (top_count >= document_to_slot_.size()) {
+        // Отсекать нечего, дешевле посчитать все документы сразу
+        TopDocuments top_documents(top_count);
+        for (const Document& document : FindAllDocuments(query, document_predicate)) {
+            top_documents.Push(document);
+        }
+        return top_documents.Extract();
+    }
+    if (has_impact_index_ && query.plus_words.size() <= IMPACT_MAX_QUERY_WORDS) {
+        return FindTopDocumentsByImpact(query, document_predicate, top_count);
+    }
+    return FindTopDocumentsPruned(query, document_predicate, top_count);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+    Query query;
+    ParseQuery(raw_query, query);
     if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("Содержимое запроса содержит недопустимые символы");
     }
+    // Пересечение списков последовательное, но и так намного дешевле параллельного объединения
+    if (IsConjunctive(query)) {
+        return FindTopDocuments(query, document_predicate, top_count);
+    }
 
     auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    SelectTopDocuments(policy, matched_documents, top_count);
 
-    sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < SET_PRECISION) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
+    QueryScratch& scratch = QueryScratch::ForCurrentThread();
+    scratch.Reset(documents_.size());
+    for (const uint32_t term_id : query.minus_words) {
+        scratch.Exclude(word_to_document_freqs_[term_id]);
+    }
+
+    size_t unchecked_postings = 0;
+    for (const uint32_t term_id : query.plus_words) {
+        const PostingList& postings = word_to_document_freqs_[term_id];
+        if (GetLiveDocumentFreq(term_id) == 0) {
+            continue;
         }
-    });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        ScorePostingBatches(postings, ComputeTermScoring(query, term_id), [&](const uint32_t* slots, const double* scores, size_t count) {
+            CheckCancellation(query, count, unchecked_postings);
+            for (size_t i = 0; i < count; ++i) {
+                if (!scratch.IsExcluded(slots[i]) && !IsDeleted(slots[i]) && Accepts(document_predicate, slots[i])) {
+                    scratch.Accumulate(slots[i], scores[i]);
+                }
+            }
+        });
     }
 
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(scratch.candidates.size());
+    for (const uint32_t slot : scratch.candidates) {
+        matched_documents.push_back({documents_[slot].id, scratch.relevance[slot], documents_[slot].rating});
+    }
     return matched_documents;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+std::vector<Document> SearchServer::FindTopDocumentsPruned(const Query& query, DocumentPredicate document_predicate, size_t top_count) const {
+    using TermCursor = QueryScratch::TermCursor;
+    const uint32_t no_slot = std::numeric_limits<uint32_t>::max();
+
+    QueryScratch& scratch = QueryScratch::ForCurrentThread();
+    scratch.Reset(documents_.size());
+    std::vector<TermCursor>& terms = scratch.terms;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const PostingList& postings = word_to_document_freqs_[query.plus_words[i]];
+        if (GetLiveDocumentFreq(query.plus_words[i]) == 0) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string{word})) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const TermScoring scoring = ComputeTermScoring(query, query.plus_words[i]);
+        terms.push_back({MakeCursor(postings, scratch), i, scoring, GetMaxPostingScore(scoring, postings.GetMaxTermFreq(), max_document_length_)});
+    }
+    for (const uint32_t term_id : query.minus_words) {
+        scratch.Exclude(word_to_document_freqs_[term_id]);
+    }
+
+    // Списки упорядочены по возрастанию максимального вклада, upper_bounds[i] — сумма вкладов списков 0..i.
+    // Списки до first_essential вместе не дают документу попасть в топ и только дополняют его релевантность
+    std::sort(terms.begin(), terms.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.max_score < rhs.max_score;
+    });
+    std::vector<double>& upper_bounds = scratch.upper_bounds;
+    double upper_bound = 0.0;
+    for (const TermCursor& term : terms) {
+        upper_bound += term.max_score;
+        upper_bounds.push_back(upper_bound);
+    }
+
+    // Вклады слов в порядке запроса, чтобы релевантность суммировалась так же, как в FindAllDocuments
+    std::vector<double>& scores = scratch.term_scores;
+    scores.assign(query.plus_words.size(), 0.0);
+    TopDocuments top_documents(top_count);
+    // Документ с релевантностью ниже порога не вытеснит худший из топа даже при большем рейтинге
+    double threshold = -std::numeric_limits<double>::infinity();
+    size_t first_essential = 0;
+
+    size_t step = 0;
+    uint32_t slot = no_slot;
+    for (const TermCursor& term : terms) {
+        if (!term.cursor.IsEnd()) {
+            slot = std::min(slot, term.cursor.GetSlot());
+        }
+    }
+
+    while (slot != no_slot) {
+        if (++step % CANCELLATION_CHECK_INTERVAL == 0) {
+            CheckCancellation(query);
+        }
+        uint32_t next_slot = no_slot;
+        double score_bound = 0.0;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            TermCursor& term = terms[i];
+            if (!term.cursor.IsEnd() && term.cursor.GetSlot() == slot) {
+                const double score = ScorePosting(term.scoring, term.cursor.GetTermFreq(), document_lengths_.data(), slot);
+                scores[term.query_index] = score;
+                score_bound += score;
+                term.cursor.Next();
+            }
+            if (!term.cursor.IsEnd()) {
+                next_slot = std::min(next_slot, term.cursor.GetSlot());
+            }
+        }
+
+        // Фильтры дешевле поиска в остальных списках и проверяются до него
+        bool is_candidate = !scratch.IsExcluded(slot) && !IsDeleted(slot) && Accepts(document_predicate, slot);
+        for (size_t i = first_essential; is_candidate && i-- > 0;) {
+            if (score_bound + upper_bounds[i] < threshold) {
+                is_candidate = false;
+                break;
+            }
+            TermCursor& term = terms[i];
+            term.cursor.Seek(slot);
+            if (!term.cursor.IsEnd() && term.cursor.GetSlot() == slot) {
+                const double score = ScorePosting(term.scoring, term.cursor.GetTermFreq(), document_lengths_.data(), slot);
+                scores[term.query_index] = score;
+                score_bound += score;
+            }
+        }
+
+        if (is_candidate) {
+            const auto& document_data = documents_[slot];
+            double relevance = 0.0;
+            for (const double score : scores) {
+                relevance += score;
+            }
+            top_documents.Push({document_data.id, relevance, document_data.rating});
+            if (top_documents.IsFull()) {
+                threshold = top_documents.Worst().relevance - 2 * SET_PRECISION;
+                while (first_essential < terms.size() && upper_bounds[first_essential] < threshold) {
+                    ++first_essential;
+                }
             }
         }
+
+        std::fill(scores.begin(), scores.end(), 0.0);
+        slot = next_slot;
+    }
+
+    return top_documents.Extract();
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const Query& query, DocumentPredicate document_predicate, size_t top_count) const {
+    using Tier = QueryScratch::ImpactTier;
+    QueryScratch& scratch = QueryScratch::ForCurrentThread();
+    scratch.Reset(documents_.size());
+    if (scratch.seen_terms.size() < documents_.size()) {
+        scratch.seen_terms.resize(documents_.size());
+    }
+    for (const uint32_t term_id : query.minus_words) {
+        scratch.Exclude(word_to_document_freqs_[term_id]);
+    }
+
+    std::vector<TermScoring>& scorings = scratch.term_scorings;
+    scorings.assign(query.plus_words.size(), TermScoring{});
+    std::vector<Tier>& tiers = scratch.impact_tiers;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const uint32_t term_id = query.plus_words[i];
+        if (GetLiveDocumentFreq(term_id) == 0) {
+            continue;
+        }
+        scorings[i] = ComputeTermScoring(query, term_id);
+        const auto impact_it = impact_postings_.find(term_id);
+        if (impact_it == impact_postings_.end()) {
+            const PostingList& postings = word_to_document_freqs_[term_id];
+            tiers.push_back({i, &postings, nullptr, nullptr, postings.size(), GetMaxPostingScore(scorings[i], postings.GetMaxTermFreq(), max_document_length_)});
+            continue;
+        }
+        const ImpactPostings& impact = impact_it->second;
+        for (const ImpactPostings::Tier& tier : impact.GetTiers()) {
+            // Вклад вхождения равен IDF, умноженному на вклад при IDF = 1; при отрицательном IDF вклады не больше нуля
+            const double max_score = std::max(0.0, scorings[i].inverse_document_freq * tier.max_impact);
+            tiers.push_back({i, nullptr, impact.GetSlots() + tier.begin, impact.GetTermFreqs() + tier.begin, tier.end - tier.begin, max_score});
+        }
+    }
+    std::stable_sort(tiers.begin(), tiers.end(), [](const Tier& lhs, const Tier& rhs) {
+        return lhs.max_score > rhs.max_score;
+    });
+
+    // remaining_scores[i] — наибольший вклад слова i в непройденных уровнях
+    std::vector<double>& remaining_scores = scratch.upper_bounds;
+    remaining_scores.assign(query.plus_words.size(), 0.0);
+    for (const Tier& tier : tiers) {
+        remaining_scores[tier.query_index] = std::max(remaining_scores[tier.query_index], tier.max_score);
     }
+    double remaining_bound = std::accumulate(remaining_scores.begin(), remaining_scores.end(), 0.0);
+    // Слово входит в документ один раз, поэтому к релевантности кандидата может добавиться
+    // лишь вклад слов, которые у него ещё не встречались; у не встреченного документа — remaining_bound
+    const auto get_upper_bound = [&](uint32_t slot) {
+        double upper_bound = remaining_bound + scratch.relevance[slot];
+        for (uint64_t seen = scratch.seen_terms[slot]; seen != 0; seen &= seen - 1) {
+            upper_bound -= remaining_scores[__builtin_ctzll(seen)];
+        }
+        return upper_bound;
+    };
+
+    double kth_relevance = 0.0;
+    size_t unchecked_postings = 0;
+    size_t postings_since_check = 0;
+    for (size_t t = 0; t < tiers.size(); ++t) {
+        const Tier& tier = tiers[t];
+        const uint64_t term_bit = uint64_t{1} << tier.query_index;
+        const auto accumulate = [&](const uint32_t* slots, const double* scores, size_t count) {
+            CheckCancellation(query, count, postings_since_check);
+            for (size_t i = 0; i < count; ++i) {
+                if (!scratch.IsExcluded(slots[i]) && !IsDeleted(slots[i]) && Accepts(document_predicate, slots[i])) {
+                    scratch.Accumulate(slots[i], scores[i], term_bit);
+                }
+            }
+        };
+        if (tier.postings != nullptr) {
+            ScorePostingBatches(*tier.postings, scorings[tier.query_index], accumulate);
+        } else {
+            double scores[SCORING_BATCH_SIZE];
+            for (size_t begin = 0; begin < tier.size; begin += SCORING_BATCH_SIZE) {
+                const size_t batch_size = std::min(SCORING_BATCH_SIZE, tier.size - begin);
+                ScorePostings(scorings[tier.query_index], tier.slots + begin, tier.term_freqs + begin, batch_size, document_lengths_.data(), scores);
+                accumulate(tier.slots + begin, scores, batch_size);
+            }
+        }
 
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        // Уровни идут по убыванию оценки, поэтому первый следующий уровень слова — самый весомый из оставшихся
+        double& remaining_score = remaining_scores[tier.query_index];
+        remaining_score = 0.0;
+        for (size_t next = t + 1; next < tiers.size(); ++next) {
+            if (tiers[next].query_index == tier.query_index) {
+                remaining_score = std::max(0.0, tiers[next].max_score);
+                break;
+            }
+        }
+        remaining_bound = std::accumulate(remaining_scores.begin(), remaining_scores.end(), 0.0);
+
+        // Документ, у которого оценка сверху ниже k-й накопленной релевантности с учётом точности сравнения,
+        // в топ уже не попадёт. Когда это верно для всех не встреченных документов, обход останавливается,
+        // если досчитать оставшихся претендентов по прямому индексу дешевле, чем пройти остальные уровни.
+        // Проверка проходит всех кандидатов, поэтому делается, лишь когда с прошлой пройдено не меньше вхождений
+        unchecked_postings += tier.size;
+        if (unchecked_postings < scratch.candidates.size()) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(std::string{word})) {
-            document_to_relevance.erase(document_id);
+        unchecked_postings = 0;
+        size_t remaining_postings = 0;
+        for (size_t next = t + 1; next < tiers.size(); ++next) {
+            remaining_postings += tiers[next].size;
+        }
+        if (remaining_postings > 0 && FindKthRelevance(scratch, top_count, kth_relevance)
+                && remaining_bound < kth_relevance - 2 * SET_PRECISION) {
+            const size_t max_contender_count = remaining_postings / query.plus_words.size();
+            size_t contender_count = 0;
+            for (const uint32_t slot : scratch.candidates) {
+                if (get_upper_bound(slot) >= kth_relevance - 2 * SET_PRECISION && ++contender_count > max_contender_count) {
+                    break;
+                }
+            }
+            if (contender_count <= max_contender_count) {
+                break;
+            }
         }
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    // Претенденты досчитываются точно, и между равными k-му с точностью SET_PRECISION выбирает рейтинг
+    double cutoff = -std::numeric_limits<double>::infinity();
+    if (FindKthRelevance(scratch, top_count, kth_relevance)) {
+        cutoff = kth_relevance - 2 * SET_PRECISION;
     }
-    return matched_documents;
+    TopDocuments top_documents(top_count);
+    for (const uint32_t slot : scratch.candidates) {
+        if (get_upper_bound(slot) < cutoff) {
+            continue;
+        }
+        // Релевантность суммируется по словам в порядке запроса, как в FindAllDocuments
+        const ForwardIndex::Entries words = forward_index_.Get(slot);
+        const uint32_t* words_end = words.term_ids + words.size;
+        double relevance = 0.0;
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            const uint32_t* word = std::lower_bound(words.term_ids, words_end, query.plus_words[i]);
+            if (word != words_end && *word == query.plus_words[i]) {
+                relevance += ScorePosting(scorings[i], words.term_freqs[word - words.term_ids], document_lengths_.data(), slot);
+            }
+        }
+        const DocumentData& document_data = documents_[slot];
+        top_documents.Push({document_data.id, relevance, document_data.rating});
+    }
+    return top_documents.Extract();
 }
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(30);
+    size_t expected_size = 0;
+    for (const uint32_t term_id : query.plus_words) {
+        expected_size += word_to_document_freqs_[term_id].size();
+    }
+    ConcurrentMap<uint32_t, double> document_to_relevance(std::min(expected_size, documents_.size()));
+
+    QueryScratch& scratch = QueryScratch::ForCurrentThread();
+    scratch.Reset(documents_.size());
+    for (const uint32_t term_id : query.minus_words) {
+        scratch.Exclude(word_to_document_freqs_[term_id]);
+    }
 
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [&](const std::string_view& word){
-        if (word_to_document_freqs_.count(word) == 0) {
+    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [&](const uint32_t term_id){
+        const PostingList& postings = word_to_document_freqs_[term_id];
+        if (GetLiveDocumentFreq(term_id) == 0) {
             return;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.find(word)->second) {
-            const auto &document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+        // Исключение нельзя бросить из параллельного обхода: отменённый запрос просто
+        // перестаёт считать, а исключение бросается после обхода
+        size_t unchecked_postings = 0;
+        ScorePostingBatches(postings, ComputeTermScoring(query, term_id), [&](const uint32_t* slots, const double* scores, size_t count) {
+            if (IsCancelled(query, count, unchecked_postings)) {
+                return;
             }
+            for (size_t i = 0; i < count; ++i) {
+                if (!scratch.IsExcluded(slots[i]) && !IsDeleted(slots[i]) && Accepts(document_predicate, slots[i])) {
+                    document_to_relevance.Add(slots[i], scores[i]);
+                }
+            }
+        });
+    });
+
+    CheckCancellation(query);
+
+    const auto result = document_to_relevance.BuildVector(policy);
+    std::vector<Document> matched_documents(result.size());
+    std::transform(policy, result.begin(), result.end(), matched_documents.begin(), [&](const auto doc){
+        return Document{documents_[doc.first].id, doc.second, documents_[doc.first].rating};
+    });
+
+    return matched_documents;
+}
+
+template <typename DocumentPredicate, typename Callback>
+void SearchServer::ForEachConjunctiveMatch(const Query& query, DocumentPredicate document_predicate, Callback callback) const {
+    using TermCursor = QueryScratch::TermCursor;
+    if (query.has_missing_required_word) {
+        return;
+    }
+    QueryScratch& scratch = QueryScratch::ForCurrentThread();
+    scratch.Reset(documents_.size());
+    for (const uint32_t term_id : query.minus_words) {
+        scratch.Exclude(word_to_document_freqs_[term_id]);
+    }
+
+    // Сначала курсоры обязательных слов по возрастанию длины списка, за ними — остальных плюс-слов
+    std::vector<TermCursor>& terms = scratch.terms;
+    size_t required_count = 0;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const uint32_t term_id = query.plus_words[i];
+        const bool is_required = std::find(query.required_words.begin(), query.required_words.end(), term_id) != query.required_words.end();
+        if (GetLiveDocumentFreq(term_id) == 0) {
+            if (is_required) {
+                return;
+            }
+            continue;
         }
+        terms.push_back({MakeCursor(word_to_document_freqs_[term_id], scratch), i, ComputeTermScoring(query, term_id), 0.0});
+        if (is_required) {
+            std::rotate(terms.begin() + required_count, terms.end() - 1, terms.end());
+            ++required_count;
+        }
+    }
+    const auto list_size = [this, &query](const TermCursor& term) {
+        return word_to_document_freqs_[query.plus_words[term.query_index]].size();
+    };
+    std::sort(terms.begin(), terms.begin() + required_count, [&list_size](const TermCursor& lhs, const TermCursor& rhs) {
+        return list_size(lhs) < list_size(rhs);
     });
+    // Обязательные слова с битовым множеством слотов, кроме ведущего
+    std::vector<const SlotBitset*>& dense_slots = scratch.dense_slots;
+    for (size_t i = 1; i < required_count; ++i) {
+        const PostingList& postings = word_to_document_freqs_[query.plus_words[terms[i].query_index]];
+        if (postings.HasDenseSlots()) {
+            dense_slots.push_back(&postings.GetDenseSlots());
+        }
+    }
 
-    std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), [&](const std::string_view& word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+    // Вклады слов в порядке запроса, чтобы релевантность суммировалась так же, как в FindAllDocuments
+    std::vector<double>& scores = scratch.term_scores;
+    scores.assign(query.plus_words.size(), 0.0);
+    PostingCursor& lead = terms.front().cursor;
+    size_t step = 0;
+    while (!lead.IsEnd()) {
+        if (++step % CANCELLATION_CHECK_INTERVAL == 0) {
+            CheckCancellation(query);
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second) {
-            document_to_relevance.erase(document_id);
+        const uint32_t slot = lead.GetSlot();
+        if (!std::all_of(dense_slots.begin(), dense_slots.end(), [slot](const SlotBitset* slots) { return slots->Test(slot); })) {
+            lead.Next();
+            continue;
+        }
+        // Отстающий курсор догоняет слот ведущего; если он его перескочил, ведущий переходит к его слоту
+        uint32_t next_slot = slot;
+        for (size_t i = 1; i < required_count; ++i) {
+            PostingCursor& cursor = terms[i].cursor;
+            cursor.Seek(slot);
+            if (cursor.IsEnd()) {
+                return;
+            }
+            if (cursor.GetSlot() != slot) {
+                next_slot = cursor.GetSlot();
+                break;
+            }
+        }
+        if (next_slot != slot) {
+            lead.Seek(next_slot);
+            continue;
+        }
+
+        if (!scratch.IsExcluded(slot) && !IsDeleted(slot) && Accepts(document_predicate, slot)) {
+            for (size_t i = 0; i < terms.size(); ++i) {
+                TermCursor& term = terms[i];
+                if (i >= required_count) {
+                    term.cursor.Seek(slot);
+                    if (term.cursor.IsEnd() || term.cursor.GetSlot() != slot) {
+                        continue;
+                    }
+                }
+                scores[term.query_index] = ScorePosting(term.scoring, term.cursor.GetTermFreq(), document_lengths_.data(), slot);
+            }
+            double relevance = 0.0;
+            for (const double score : scores) {
+                relevance += score;
+            }
+            callback(slot, relevance);
+            std::fill(scores.begin(), scores.end(), 0.0);
+        }
+        lead.Next();
+    }
+}
+
+template <typename Callback>
+void SearchServer::ScorePostingBatches(const PostingList& postings, const TermScoring& scoring, Callback callback) const {
+    double scores[SCORING_BATCH_SIZE];
+    postings.ForEachBlock(document_lengths_.data(), [&](const uint32_t* slots, const double* term_freqs, size_t count) {
+        for (size_t begin = 0; begin < count; begin += SCORING_BATCH_SIZE) {
+            const size_t batch_size = std::min(SCORING_BATCH_SIZE, count - begin);
+            ScorePostings(scoring, slots + begin, term_freqs + begin, batch_size, document_lengths_.data(), scores);
+            callback(slots + begin, scores, batch_size);
         }
     });
+}
 
-    std::map<int, double> result = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(result.size());
-    std::for_each(policy, result.begin(), result.end(), [&](const auto doc){
-        matched_documents.emplace_back(doc.first, doc.second, documents_.at(doc.first).rating);
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocument(ExecutionPolicy, int document_id) {
+    // Удаление не обходит списки вхождений, распараллеливать нечего
+    RemoveDocument(document_id);
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::exception_ptr> SearchServer::AddDocuments(ExecutionPolicy policy, const std::vector<NewDocument>& documents) {
+    if (duplicate_mode_ != DuplicateMode::IGNORE) {
+        return AddDocumentsCheckingDuplicates(policy, documents);
+    }
+    std::vector<std::exception_ptr> errors(documents.size());
+    std::vector<char> is_valid_text(documents.size());
+    std::transform(policy, documents.begin(), documents.end(), is_valid_text.begin(), [](const NewDocument& document) {
+        return IsValidWord(document.text);
     });
 
-    return matched_documents;
+    // Проверки id зависят от индекса и от предыдущих документов пакета, поэтому идут по порядку.
+    // Принятый документ сразу получает слот — тот же, что при последовательных вызовах AddDocument
+    std::vector<const NewDocument*> accepted;
+    std::vector<uint32_t> slots;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const NewDocument& document = documents[i];
+        try {
+            CheckNewDocument(document.id, is_valid_text[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+            continue;
+        }
+        if (log_) {
+            log_sequence_number_ = log_->LogAddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        accepted.push_back(&document);
+        slots.push_back(AllocateSlot({document.id, ComputeAverageRating(document.ratings), document.status, 0}));
+        document_ids_.insert(document.id);
+    }
+    if (log_ && !accepted.empty()) {
+        log_->WaitDurable(log_sequence_number_);
+    }
+
+    // Каждая часть пакета разбивается на слова со своим словарём. Затем словари частей по порядку
+    // добавляются в общий, и id слов получаются те же, что при последовательном добавлении
+    struct Chunk {
+        size_t begin;
+        size_t end;
+        std::unordered_map<std::string_view, uint32_t> term_ids;
+        std::vector<std::string_view> terms;
+        std::vector<uint32_t> to_global;
+    };
+    const size_t max_chunk_count = 4 * std::max(1u, std::thread::hardware_concurrency());
+    const size_t chunk_count = std::min((accepted.size() + MIN_DOCUMENTS_PER_CHUNK - 1) / MIN_DOCUMENTS_PER_CHUNK, max_chunk_count);
+    std::vector<Chunk> chunks(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = accepted.size() * i / chunk_count;
+        chunks[i].end = accepted.size() * (i + 1) / chunk_count;
+    }
+    std::vector<std::vector<uint32_t>> document_terms(accepted.size());
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](Chunk& chunk) {
+        for (size_t i = chunk.begin; i < chunk.end; ++i) {
+            for (const std::string_view word : SplitIntoWordsNoStop(accepted[i]->text)) {
+                const auto [it, inserted] = chunk.term_ids.emplace(word, static_cast<uint32_t>(chunk.terms.size()));
+                if (inserted) {
+                    chunk.terms.push_back(word);
+                }
+                document_terms[i].push_back(it->second);
+            }
+        }
+    });
+    for (Chunk& chunk : chunks) {
+        chunk.to_global.reserve(chunk.terms.size());
+        for (const std::string_view term : chunk.terms) {
+            chunk.to_global.push_back(terms_.Intern(term));
+        }
+    }
+    if (word_to_document_freqs_.size() < terms_.size()) {
+        word_to_document_freqs_.resize(terms_.size());
+    }
+
+    std::vector<std::vector<TermFreq>> document_words(accepted.size());
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](const Chunk& chunk) {
+        for (size_t i = chunk.begin; i < chunk.end; ++i) {
+            std::vector<uint32_t>& term_ids = document_terms[i];
+            for (uint32_t& term_id : term_ids) {
+                term_id = chunk.to_global[term_id];
+            }
+            documents_[slots[i]].word_count = static_cast<uint32_t>(term_ids.size());
+            document_lengths_[slots[i]] = documents_[slots[i]].word_count;
+            document_words[i] = ComputeTermFreqs(term_ids);
+            std::vector<uint32_t>().swap(term_ids);
+        }
+    });
+
+    // Вхождения пакета раскладываются по словам сортировкой подсчётом, внутри слова — по возрастанию слота.
+    // Затем каждый список вхождений пополняется одним слиянием; разные списки пополняются параллельно
+    std::vector<size_t> term_offsets(terms_.size() + 1, 0);
+    for (const auto& word_freqs : document_words) {
+        for (const TermFreq& term_freq : word_freqs) {
+            ++term_offsets[term_freq.term_id + 1];
+        }
+    }
+    std::partial_sum(term_offsets.begin(), term_offsets.end(), term_offsets.begin());
+    std::vector<uint32_t> posting_slots(term_offsets.back());
+    std::vector<double> posting_term_freqs(term_offsets.back());
+    {
+        std::vector<size_t> positions(term_offsets.begin(), term_offsets.end() - 1);
+        for (size_t i = 0; i < accepted.size(); ++i) {
+            for (const TermFreq& term_freq : document_words[i]) {
+                const size_t pos = positions[term_freq.term_id]++;
+                posting_slots[pos] = slots[i];
+                posting_term_freqs[pos] = term_freq.freq;
+            }
+        }
+    }
+    // Слоты пакета возрастают, если не переиспользуются слоты удалённых документов
+    const bool are_slots_sorted = std::is_sorted(slots.begin(), slots.end());
+    std::vector<uint32_t> term_ids(terms_.size());
+    std::iota(term_ids.begin(), term_ids.end(), 0);
+    std::for_each(policy, term_ids.begin(), term_ids.end(), [&](uint32_t term_id) {
+        const size_t begin = term_offsets[term_id];
+        const size_t count = term_offsets[term_id + 1] - begin;
+        if (count == 0) {
+            return;
+        }
+        if (!are_slots_sorted) {
+            std::vector<std::pair<uint32_t, double>> term_postings(count);
+            for (size_t i = 0; i < count; ++i) {
+                term_postings[i] = {posting_slots[begin + i], posting_term_freqs[begin + i]};
+            }
+            std::sort(term_postings.begin(), term_postings.end());
+            for (size_t i = 0; i < count; ++i) {
+                std::tie(posting_slots[begin + i], posting_term_freqs[begin + i]) = term_postings[i];
+            }
+        }
+        GetMutablePostings(term_id).AddSorted(&posting_slots[begin], &posting_term_freqs[begin], count);
+    });
+
+    for (size_t i = 0; i < accepted.size(); ++i) {
+        forward_index_.Set(slots[i], document_words[i]);
+        CountDocumentLength(slots[i]);
+        RegisterFingerprint(accepted[i]->id);
+    }
+    return errors;
 }
 
 template <typename ExecutionPolicy>
-void SearchServer::RemoveDocument(ExecutionPolicy policy, int document_id) {
-    document_ids_.erase(document_id);
-    auto &word_freq = words_to_id_.at(document_id);
-    std::vector<const std::string*> temp;
-    temp.resize(word_freq.size());
-
-    std::transform(policy, word_freq.begin(), word_freq.end(), temp.begin(), [](const std::pair<const std::string, double>& words_to_id){
-        return &words_to_id.first;
+std::vector<std::exception_ptr> SearchServer::AddDocumentsCheckingDuplicates(ExecutionPolicy policy, const std::vector<NewDocument>& documents) {
+    std::vector<std::vector<std::string_view>> document_words(documents.size());
+    std::vector<char> is_valid_text(documents.size());
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        is_valid_text[i] = TokenizeText(documents[i].text, document_words[i]);
+        RemoveStopWords(document_words[i]);
     });
 
-    std::for_each(policy, temp.begin(), temp.end(), [&](const std::string* word){
-        word_to_document_freqs_.at(*word).erase(document_id);
+    std::vector<std::exception_ptr> errors(documents.size());
+    bool is_logged = false;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const NewDocument& document = documents[i];
+        bool is_duplicate;
+        try {
+            CheckNewDocument(document.id, is_valid_text[i]);
+            is_duplicate = CheckDuplicate(document_words[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+            continue;
+        }
+        if (log_) {
+            log_sequence_number_ = log_->LogAddDocument(document.id, document.text, document.status, document.ratings);
+            is_logged = true;
+        }
+        AddDocumentWords(document.id, document_words[i], document.status, document.ratings);
+        if (is_duplicate) {
+            flagged_duplicates_.insert(document.id);
+        }
+    }
+    if (is_logged) {
+        log_->WaitDurable(log_sequence_number_);
+    }
+    return errors;
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::OpenWriteAheadLog(ExecutionPolicy policy, const std::string& path) {
+    if (log_) {
+        throw std::logic_error("Журнал уже открыт");
+    }
+    const LogContents contents = WriteAheadLog::Read(policy, path);
+    // Разбиение на слова не зависит от индекса и выполняется параллельно,
+    // сами изменения применяются строго в порядке журнала
+    std::vector<std::vector<std::string_view>> document_words(contents.records.size());
+    std::transform(policy, contents.records.begin(), contents.records.end(), document_words.begin(), [this](const LogRecord& record) {
+        if (record.type != LogRecord::Type::ADD_DOCUMENT || record.sequence_number <= log_sequence_number_) {
+            return std::vector<std::string_view>{};
+        }
+        return SplitIntoWordsNoStop(record.document);
     });
+    for (size_t i = 0; i < contents.records.size(); ++i) {
+        const LogRecord& record = contents.records[i];
+        if (record.sequence_number <= log_sequence_number_) {
+            continue;
+        }
+        if (record.type == LogRecord::Type::ADD_DOCUMENT) {
+            CheckNewDocument(record.document_id, IsValidWord(record.document));
+            AddDocumentWords(record.document_id, document_words[i], record.status, record.ratings);
+        } else if (const auto slot_it = document_to_slot_.find(record.document_id); slot_it != document_to_slot_.end()) {
+            // Удаление отсутствующего документа пропускается, как в RemoveDocuments, а не прерывает восстановление
+            MarkDeleted(record.document_id, slot_it->second);
+            CompactIfNeeded();
+        }
+        log_sequence_number_ = record.sequence_number;
+    }
+    log_ = std::make_unique<WriteAheadLog>(path, contents, log_sequence_number_);
+}
 
-    words_to_id_.erase(document_id);
-    documents_.erase(document_id);
-}
\ No newline at end of file
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view& raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
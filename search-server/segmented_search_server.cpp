@@ -0,0 +1,245 @@
+#include "segmented_search_server.h"
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+SegmentedSearchServer::SegmentedSearchServer(const string& stop_words_text, size_t segment_size, RefreshPolicy refresh_policy)
+        : SegmentedSearchServer(SplitIntoWords(stop_words_text), segment_size, refresh_policy) {
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    merge_state_changed_.notify_all();
+    merge_thread_.join();
+    delete current_version_.load();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, const string_view& document, DocumentStatus status, const vector<int>& ratings) {
+    lock_guard lock(mutex_);
+    if (document_to_segment_.count(document_id) > 0) {
+        throw invalid_argument("Документ с таким id уже существует."s);
+    }
+    mutable_segment_->AddDocument(document_id, document, status, ratings);
+    document_to_segment_.emplace(document_id, mutable_segment_.get());
+    if (static_cast<size_t>(mutable_segment_->GetDocumentCount()) >= segment_size_) {
+        FreezeMutableSegment();
+        Publish();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    lock_guard lock(mutex_);
+    const auto it = document_to_segment_.find(document_id);
+    if (it == document_to_segment_.end()) {
+        return;
+    }
+    const SearchServer* index = it->second;
+    document_to_segment_.erase(it);
+    if (index == mutable_segment_.get()) {
+        mutable_segment_->RemoveDocument(document_id);
+        return;
+    }
+    const auto position = FindSegment(index);
+    if (position->use_count() > 1) {
+        *position = make_shared<Segment>(**position);
+    }
+    Segment& segment = **position;
+    segment.removed_ids.insert(document_id);
+    for (const auto& [word, freq] : segment.index->GetWordFrequencies(document_id)) {
+        ++segment.removed_document_freqs[word];
+    }
+    if (PickMerge().size() > 0) {
+        merge_state_changed_.notify_all();
+    }
+    if (refresh_policy_ == RefreshPolicy::AFTER_EACH_WRITE) {
+        Publish();
+    }
+}
+
+void SegmentedSearchServer::Refresh() {
+    lock_guard lock(mutex_);
+    if (mutable_segment_->GetDocumentCount() > 0) {
+        FreezeMutableSegment();
+    }
+    Publish();
+}
+
+SegmentedSearchServer::Reader SegmentedSearchServer::GetReader() const {
+    // Эпоха объявляется до чтения версии: писатель, заменивший версию после этого,
+    // увидит объявление и не освободит её
+    EpochManager::Guard guard = epochs_.Pin();
+    const Version* version = current_version_.load();
+    return Reader(move(guard), version, &empty_index_);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(const string_view& raw_query, DocumentStatus status, size_t top_count) const {
+    return GetReader().FindTopDocuments(raw_query, status, top_count);
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    lock_guard lock(mutex_);
+    return static_cast<int>(document_to_segment_.size());
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    lock_guard lock(mutex_);
+    return segments_.size();
+}
+
+void SegmentedSearchServer::WaitForMerges() const {
+    unique_lock lock(mutex_);
+    merge_state_changed_.wait(lock, [this] {
+        return !is_merging_ && PickMerge().empty();
+    });
+}
+
+void SegmentedSearchServer::FreezeMutableSegment() {
+    auto segment = make_shared<Segment>();
+    segment->index = move(mutable_segment_);
+    segments_.push_back(move(segment));
+    mutable_segment_ = make_unique<SearchServer>(stop_words_);
+    merge_state_changed_.notify_all();
+}
+
+void SegmentedSearchServer::Publish() {
+    auto version = make_unique<Version>();
+    version->segments.assign(segments_.begin(), segments_.end());
+    for (const auto& segment : segments_) {
+        version->document_count += segment->index->GetDocumentCount() - static_cast<int>(segment->removed_ids.size());
+    }
+    const Version* old_version = current_version_.exchange(version.release());
+    retired_versions_.emplace_back(epochs_.Advance(), old_version);
+
+    const uint64_t oldest_epoch = epochs_.GetOldestActiveEpoch();
+    retired_versions_.erase(remove_if(retired_versions_.begin(), retired_versions_.end(), [oldest_epoch](const auto& retired) {
+        return retired.first < oldest_epoch;
+    }), retired_versions_.end());
+}
+
+vector<shared_ptr<SegmentedSearchServer::Segment>>::iterator SegmentedSearchServer::FindSegment(const SearchServer* index) {
+    return find_if(segments_.begin(), segments_.end(), [index](const shared_ptr<Segment>& segment) {
+        return segment->index.get() == index;
+    });
+}
+
+// Уровень сегмента растёт на единицу с каждым MERGE_FACTOR-кратным ростом размера
+size_t SegmentedSearchServer::GetLevel(int document_count) const {
+    size_t level = 0;
+    for (size_t bound = segment_size_ * MERGE_FACTOR; static_cast<size_t>(document_count) >= bound; bound *= MERGE_FACTOR) {
+        ++level;
+    }
+    return level;
+}
+
+vector<shared_ptr<SegmentedSearchServer::Segment>> SegmentedSearchServer::PickMerge() const {
+    // Сегмент, где удалено больше половины документов, переписывается отдельно
+    for (const auto& segment : segments_) {
+        if (segment->removed_ids.size() * 2 > static_cast<size_t>(segment->index->GetDocumentCount())) {
+            return {segment};
+        }
+    }
+    map<size_t, vector<shared_ptr<Segment>>> segments_by_level;
+    for (const auto& segment : segments_) {
+        const int live_count = segment->index->GetDocumentCount() - static_cast<int>(segment->removed_ids.size());
+        auto& level_segments = segments_by_level[GetLevel(live_count)];
+        level_segments.push_back(segment);
+        if (level_segments.size() == MERGE_FACTOR) {
+            return level_segments;
+        }
+    }
+    return {};
+}
+
+void SegmentedSearchServer::RunMerges() {
+    unique_lock lock(mutex_);
+    while (true) {
+        merge_state_changed_.wait(lock, [this] {
+            return is_stopping_ || !PickMerge().empty();
+        });
+        if (is_stopping_) {
+            return;
+        }
+        // Копии сегментов на момент начала слияния: удаления во время слияния попадут в новые копии
+        const vector<shared_ptr<Segment>> sources = PickMerge();
+        is_merging_ = true;
+        lock.unlock();
+
+        // Сегменты неизменяемы, поэтому сливаются без блокировки, пока идут запросы и запись
+        SearchServer merged(stop_words_);
+        for (const auto& source : sources) {
+            merged.AddDocumentsFrom(*source->index, source->removed_ids);
+        }
+
+        lock.lock();
+        // Документы, удалённые во время слияния
+        for (const auto& source : sources) {
+            for (const int document_id : (*FindSegment(source->index.get()))->removed_ids) {
+                if (source->removed_ids.count(document_id) == 0) {
+                    merged.RemoveDocument(document_id);
+                }
+            }
+        }
+        auto segment = make_shared<Segment>();
+        segment->index = make_shared<const SearchServer>(move(merged));
+        for (const int document_id : *segment->index) {
+            document_to_segment_[document_id] = segment->index.get();
+        }
+
+        const auto position = FindSegment(sources.front()->index.get());
+        if (segment->index->GetDocumentCount() > 0) {
+            *position = move(segment);
+        } else {
+            segments_.erase(position);
+        }
+        for (size_t i = 1; i < sources.size(); ++i) {
+            segments_.erase(FindSegment(sources[i]->index.get()));
+        }
+        Publish();
+        is_merging_ = false;
+        merge_state_changed_.notify_all();
+    }
+}
+
+SegmentedSearchServer::Reader::Reader(EpochManager::Guard guard, const Version* version, const SearchServer* empty_index)
+        : guard_(move(guard))
+        , version_(version)
+        , empty_index_(empty_index) {
+}
+
+vector<Document> SegmentedSearchServer::Reader::FindTopDocuments(const string_view& raw_query, DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(raw_query, StatusIs{status}, top_count);
+}
+
+MatchedDocuments SegmentedSearchServer::Reader::MatchDocument(const string_view& raw_query, int document_id) const {
+    for (const auto& segment : version_->segments) {
+        if (segment->removed_ids.count(document_id) == 0 && segment->index->HasDocument(document_id)) {
+            return segment->index->MatchDocument(raw_query, document_id);
+        }
+    }
+    throw out_of_range("There is no document with such id");
+}
+
+int SegmentedSearchServer::Reader::GetDocumentCount() const {
+    return version_->document_count;
+}
+
+CollectionStatistics SegmentedSearchServer::Reader::GetStatistics() const {
+    CollectionStatistics statistics;
+    statistics.document_count = version_->document_count;
+    statistics.document_freq = [version = version_](string_view word) {
+        int document_freq = 0;
+        for (const auto& segment : version->segments) {
+            document_freq += segment->index->GetDocumentFreq(word);
+            const auto it = segment->removed_document_freqs.find(word);
+            if (it != segment->removed_document_freqs.end()) {
+                document_freq -= it->second;
+            }
+        }
+        return document_freq;
+    };
+    return statistics;
+}
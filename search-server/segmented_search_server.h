@@ -0,0 +1,209 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "epoch_manager.h"
+#include "search_server.h"
+
+// Индекс из неизменяемых сегментов и небольшого изменяемого сегмента, куда попадают новые документы.
+// Заполненный изменяемый сегмент замораживается, а фоновый поток сливает сегменты одного уровня
+// по MERGE_FACTOR штук. Удалённый из неизменяемого сегмента документ только помечается
+// и отбрасывается при слиянии. IDF считается по всей коллекции, поэтому релевантность та же,
+// что у одного SearchServer с теми же документами.
+//
+// Читатели ищут в опубликованной версии — неизменяемом наборе сегментов — и не берут блокировок.
+// Изменения видны читателям после публикации, момент которой задаёт RefreshPolicy.
+// Заменённые версии освобождаются по эпохам, когда их больше не читает ни один Reader
+class SegmentedSearchServer {
+public:
+    static constexpr size_t DEFAULT_SEGMENT_SIZE = 4096;
+    static constexpr size_t MERGE_FACTOR = 4;
+
+    class Reader;
+
+    // Когда изменения становятся видны читателям
+    enum class RefreshPolicy {
+        // При вызове Refresh, при заморозке заполненного изменяемого сегмента и после каждого слияния.
+        // AddDocument и RemoveDocument сами по себе не видны поиску
+        EXPLICIT,
+        // Сразу по возвращении из AddDocument и RemoveDocument: каждый документ замораживается
+        // в отдельный сегмент, и фоновый поток сливает мелкие сегменты. segment_size не используется
+        AFTER_EACH_WRITE,
+    };
+
+    // segment_size — сколько документов набирается в изменяемом сегменте до заморозки
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words, size_t segment_size = DEFAULT_SEGMENT_SIZE,
+                                   RefreshPolicy refresh_policy = RefreshPolicy::EXPLICIT);
+    explicit SegmentedSearchServer(const std::string& stop_words_text, size_t segment_size = DEFAULT_SEGMENT_SIZE,
+                                   RefreshPolicy refresh_policy = RefreshPolicy::EXPLICIT);
+    // Все Reader должны быть уничтожены раньше индекса
+    ~SegmentedSearchServer();
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    // Публикует все сделанные до вызова изменения
+    void Refresh();
+
+    // Закрепляет текущую опубликованную версию индекса за читателем
+    Reader GetReader() const;
+
+    // Поиск в текущей опубликованной версии
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Число документов вместе с ещё не опубликованными
+    int GetDocumentCount() const;
+    // Число неизменяемых сегментов
+    size_t GetSegmentCount() const;
+    // Дожидается, пока фоновый поток выполнит все назревшие слияния
+    void WaitForMerges() const;
+
+private:
+    struct Segment {
+        std::shared_ptr<const SearchServer> index;
+        // Удалённые документы и сколько из них содержат каждое слово
+        std::set<int> removed_ids;
+        std::unordered_map<std::string_view, int> removed_document_freqs;
+    };
+
+    // Опубликованное состояние индекса; после публикации не меняется
+    struct Version {
+        std::vector<std::shared_ptr<const Segment>> segments;
+        int document_count = 0;
+    };
+
+    const std::vector<std::string> stop_words_;
+    const RefreshPolicy refresh_policy_;
+    const size_t segment_size_;
+    // Пустой индекс проверяет запрос, когда в версии нет сегментов
+    const SearchServer empty_index_;
+
+    mutable EpochManager epochs_;
+    std::atomic<const Version*> current_version_;
+
+    // Состояние писателя, меняется под mutex_. Сегмент, который уже попал в опубликованную
+    // версию, перед изменением копируется
+    mutable std::mutex mutex_;
+    std::unique_ptr<SearchServer> mutable_segment_;
+    std::vector<std::shared_ptr<Segment>> segments_;
+    // Индекс сегмента, где лежит каждый документ
+    std::unordered_map<int, const SearchServer*> document_to_segment_;
+    // Заменённые версии и эпохи, в которые их заменили
+    std::vector<std::pair<uint64_t, std::unique_ptr<const Version>>> retired_versions_;
+
+    mutable std::condition_variable merge_state_changed_;
+    bool is_merging_ = false;
+    bool is_stopping_ = false;
+    std::thread merge_thread_;
+
+    // Вызываются под mutex_
+    void FreezeMutableSegment();
+    void Publish();
+    std::vector<std::shared_ptr<Segment>>::iterator FindSegment(const SearchServer* index);
+    std::vector<std::shared_ptr<Segment>> PickMerge() const;
+    size_t GetLevel(int document_count) const;
+
+    void RunMerges();
+};
+
+// Закреплённая версия индекса. Пока Reader жив, версия не освобождается, и строки,
+// которые вернул MatchDocument, остаются действительными. Reader не блокирует писателей
+class SegmentedSearchServer::Reader {
+public:
+    // Сегменты просматриваются параллельно, лучшие документы каждого сливаются в общий топ
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    MatchedDocuments MatchDocument(const std::string_view& raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+private:
+    friend class SegmentedSearchServer;
+
+    Reader(EpochManager::Guard guard, const Version* version, const SearchServer* empty_index);
+
+    EpochManager::Guard guard_;
+    const Version* version_;
+    const SearchServer* empty_index_;
+
+    CollectionStatistics GetStatistics() const;
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer& stop_words, size_t segment_size, RefreshPolicy refresh_policy)
+        : stop_words_(stop_words.begin(), stop_words.end())
+        , refresh_policy_(refresh_policy)
+        // Сегменты из одного документа: заморозка и публикация после каждого добавления
+        , segment_size_(refresh_policy == RefreshPolicy::AFTER_EACH_WRITE ? 1 : std::max<size_t>(segment_size, 1))
+        , empty_index_(stop_words_)
+        , current_version_(new Version)
+        , mutable_segment_(std::make_unique<SearchServer>(stop_words_))
+        , merge_thread_([this] { RunMerges(); }) {
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+    return GetReader().FindTopDocuments(raw_query, document_predicate, top_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::Reader::FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, size_t top_count) const {
+    const CollectionStatistics statistics = GetStatistics();
+    const auto& segments = version_->segments;
+    if (segments.empty()) {
+        return empty_index_->FindTopDocuments(raw_query, document_predicate, top_count, statistics);
+    }
+
+    // Ошибка в запросе не должна покинуть параллельный обход, она передаётся вызывающему после него
+    std::vector<std::vector<Document>> segment_documents(segments.size());
+    std::vector<std::exception_ptr> errors(segments.size());
+    std::vector<size_t> indexes(segments.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        const Segment& segment = *segments[index];
+        try {
+            // Без удалённых документов предикат передаётся как есть, и сегмент может его распознать
+            if (segment.removed_ids.empty()) {
+                segment_documents[index] = segment.index->FindTopDocuments(raw_query, document_predicate, top_count, statistics);
+                return;
+            }
+            segment_documents[index] = segment.index->FindTopDocuments(raw_query, [&](int document_id, DocumentStatus status, int rating) {
+                return segment.removed_ids.count(document_id) == 0 && document_predicate(document_id, status, rating);
+            }, top_count, statistics);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    TopDocuments top_documents(top_count);
+    for (const auto& documents : segment_documents) {
+        for (const Document& document : documents) {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.Extract();
+}
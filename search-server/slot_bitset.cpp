@@ -0,0 +1,28 @@
+#include "slot_bitset.h"
+#include <algorithm>
+
+using namespace std;
+
+void SlotBitset::Resize(size_t slot_count) {
+    const size_t word_count = (slot_count + 63) / 64;
+    if (words_.size() < word_count) {
+        words_.resize(word_count, 0);
+    }
+}
+
+void SlotBitset::Union(const SlotBitset& other) {
+    if (words_.size() < other.words_.size()) {
+        words_.resize(other.words_.size(), 0);
+    }
+    for (size_t i = 0; i < other.words_.size(); ++i) {
+        words_[i] |= other.words_[i];
+    }
+}
+
+void SlotBitset::Clear() {
+    fill(words_.begin(), words_.end(), 0);
+}
+
+bool SlotBitset::empty() const {
+    return words_.empty();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Плотное битовое множество слотов документов
+class SlotBitset {
+public:
+    // Увеличивает размер множества до slot_count слотов, не меняя установленные биты
+    void Resize(size_t slot_count);
+
+    void Set(uint32_t slot) {
+        const size_t index = slot / 64;
+        if (index >= words_.size()) {
+            words_.resize(index + 1, 0);
+        }
+        words_[index] |= uint64_t{1} << (slot % 64);
+    }
+
+    void Reset(uint32_t slot) {
+        const size_t index = slot / 64;
+        if (index < words_.size()) {
+            words_[index] &= ~(uint64_t{1} << (slot % 64));
+        }
+    }
+
+    bool Test(uint32_t slot) const {
+        const size_t index = slot / 64;
+        return index < words_.size() && (words_[index] >> (slot % 64)) & 1;
+    }
+
+    void Union(const SlotBitset& other);
+    void Clear();
+    bool empty() const;
+
+private:
+    std::vector<uint64_t> words_;
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Вектор, первые N элементов которого хранятся внутри объекта: пока элементов не больше N,
+// память не выделяется. Для тривиально копируемых типов
+template <typename T, size_t N>
+class SmallVector {
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVector supports only trivially copyable values");
+
+    SmallVector() = default;
+
+    SmallVector(const SmallVector& other) {
+        *this = other;
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            clear();
+            reserve(other.size_);
+            std::copy(other.begin(), other.end(), data_);
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    void push_back(const T& value) {
+        if (size_ == capacity_) {
+            reserve(capacity_ * 2);
+        }
+        data_[size_++] = value;
+    }
+
+    void reserve(size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        std::unique_ptr<T[]> heap(new T[capacity]);
+        std::copy(begin(), end(), heap.get());
+        heap_ = std::move(heap);
+        data_ = heap_.get();
+        capacity_ = capacity;
+    }
+
+    // Удаляет элементы [first, last); выделенная память остаётся за вектором
+    void erase(T* first, T* last) {
+        std::copy(last, end(), first);
+        size_ -= last - first;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+
+    T* begin() {
+        return data_;
+    }
+    T* end() {
+        return data_ + size_;
+    }
+    const T* begin() const {
+        return data_;
+    }
+    const T* end() const {
+        return data_ + size_;
+    }
+
+    T& operator[](size_t index) {
+        return data_[index];
+    }
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    T inline_[N];
+    std::unique_ptr<T[]> heap_;
+    T* data_ = inline_;
+    size_t size_ = 0;
+    size_t capacity_ = N;
+};
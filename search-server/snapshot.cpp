@@ -0,0 +1,203 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'V', 'S', 'N', 'A', 'P', '\0'};
+// Снимок читается как есть, поэтому файл с другим порядком байт отвергается
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const size_t ALIGNMENT = 8;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+};
+
+size_t AlignUp(size_t position) {
+    return (position + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+void SyncPath(const string& path, int flags) {
+    const int fd = open(path.c_str(), flags);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть "s + path + ": "s + strerror(errno));
+    }
+    const int result = fsync(fd);
+    const int error = errno;
+    close(fd);
+    if (result != 0) {
+        throw runtime_error("Ошибка сброса на диск "s + path + ": "s + strerror(error));
+    }
+}
+
+string GetDirectory(const string& path) {
+    const size_t slash = path.rfind('/');
+    if (slash == string::npos) {
+        return "."s;
+    }
+    return slash == 0 ? "/"s : path.substr(0, slash);
+}
+
+}  // namespace
+
+SnapshotWriter::SnapshotWriter(const string& path)
+        : path_(path)
+        , temp_path_(path + ".tmp"s)
+        , output_(temp_path_, ios::binary | ios::trunc) {
+    if (!output_) {
+        throw runtime_error("Не удалось открыть файл снимка "s + temp_path_);
+    }
+    const SnapshotHeader header{};
+    WriteBytes(&header, sizeof(header));
+}
+
+void SnapshotWriter::EndArray() {
+    if (array_remaining_ != 0) {
+        throw logic_error("Массив снимка короче объявленного"s);
+    }
+    Align();
+}
+
+void SnapshotWriter::Finish() {
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.file_size = position_;
+    output_.seekp(0);
+    output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output_.close();
+    if (!output_) {
+        throw runtime_error("Ошибка записи снимка"s);
+    }
+    // Сначала данные, затем запись каталога о переименовании
+    SyncPath(temp_path_, O_WRONLY);
+    if (rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        throw runtime_error("Не удалось переименовать снимок в "s + path_ + ": "s + strerror(errno));
+    }
+    is_finished_ = true;
+    SyncPath(GetDirectory(path_), O_RDONLY | O_DIRECTORY);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!is_finished_) {
+        output_.close();
+        unlink(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    output_.write(static_cast<const char*>(data), size);
+    if (!output_) {
+        throw runtime_error("Ошибка записи снимка"s);
+    }
+    position_ += size;
+}
+
+void SnapshotWriter::Align() {
+    static const char padding[ALIGNMENT] = {};
+    WriteBytes(padding, AlignUp(position_) - position_);
+}
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть файл снимка "s + path);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        throw runtime_error("Файл снимка пуст или недоступен: "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw runtime_error("Не удалось отобразить в память файл снимка "s + path);
+    }
+    // Страницы подгружаются с диска заранее и в фоне, запросы не ждут каждую по отдельности
+    madvise(data, size_, MADV_WILLNEED);
+    data_ = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data_), size_);
+}
+
+const char* MappedFile::data() const {
+    return data_;
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
+
+SnapshotReader::SnapshotReader(const MappedFile& file)
+        : data_(file.data())
+        , size_(file.size())
+        , position_(sizeof(SnapshotHeader)) {
+    SnapshotHeader header;
+    if (size_ < sizeof(header)) {
+        throw runtime_error("Файл не является снимком индекса"s);
+    }
+    memcpy(&header, data_, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.byte_order != BYTE_ORDER_MARK) {
+        throw runtime_error("Файл не является снимком индекса"s);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw runtime_error("Неподдерживаемая версия снимка "s + to_string(header.version));
+    }
+    if (header.file_size != size_) {
+        throw runtime_error("Снимок повреждён: размер файла не совпадает с заголовком"s);
+    }
+}
+
+StringTable SnapshotReader::ReadStrings() {
+    const auto chars = ReadArray<char>();
+    const auto offsets = ReadArray<uint64_t>();
+    if (offsets.size == 0 || offsets.data[0] != 0) {
+        throw runtime_error("Снимок повреждён: неверная таблица строк"s);
+    }
+    for (size_t i = 1; i < offsets.size; ++i) {
+        if (offsets.data[i] < offsets.data[i - 1] || offsets.data[i] > chars.size) {
+            throw runtime_error("Снимок повреждён: неверная таблица строк"s);
+        }
+    }
+    return {chars.data, offsets.data, offsets.size - 1};
+}
+
+void SnapshotReader::Finish() const {
+    if (position_ != size_) {
+        throw runtime_error("Снимок повреждён: лишние данные в конце файла"s);
+    }
+}
+
+const char* SnapshotReader::ReadArrayData(size_t element_size, size_t alignment, size_t& count) {
+    uint64_t header[2];
+    if (size_ - position_ < sizeof(header)) {
+        throw runtime_error("Снимок повреждён: файл обрывается"s);
+    }
+    memcpy(header, data_ + position_, sizeof(header));
+    if (header[1] != element_size || alignment > ALIGNMENT) {
+        throw runtime_error("Снимок повреждён: неожиданный тип массива"s);
+    }
+    position_ += sizeof(header);
+    if (header[0] > (size_ - position_) / element_size) {
+        throw runtime_error("Снимок повреждён: файл обрывается"s);
+    }
+    const char* data = data_ + position_;
+    count = header[0];
+    position_ = min(AlignUp(position_ + count * element_size), size_);
+    return data;
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+using namespace std::string_literals;
+
+// Снимок индекса на диске: заголовок и последовательность массивов, каждый из которых
+// выровнен по 8 байт и начинается с числа и размера элементов. Массивы читаются
+// прямо из отображённого в память файла, без разбора и копирования
+
+const uint32_t SNAPSHOT_VERSION = 3;
+
+// Набор строк снимка: символы подряд и смещения начала каждой строки
+struct StringTable {
+    const char* chars = nullptr;
+    const uint64_t* offsets = nullptr;
+    size_t count = 0;
+
+    std::string_view operator[](size_t index) const {
+        return {chars + offsets[index], static_cast<size_t>(offsets[index + 1] - offsets[index])};
+    }
+};
+
+// Снимок пишется во временный файл path + ".tmp" и занимает место path только в Finish,
+// после сброса на диск. Прежний файл не перезаписывается, поэтому отображённый в память
+// снимок, из которого загружен индекс, остаётся целым, а сбой посреди записи его не портит
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+    // Недописанный снимок удаляется
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Массив можно записывать частями: BeginArray, несколько Append и EndArray
+    template <typename T>
+    void BeginArray(size_t count);
+    template <typename T>
+    void Append(const T* data, size_t count);
+    void EndArray();
+
+    template <typename T>
+    void WriteArray(const std::vector<T>& data);
+    template <typename StringContainer>
+    void WriteStrings(const StringContainer& strings);
+
+    // Дописывает заголовок, сбрасывает файл на диск и переименовывает его в path
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream output_;
+    bool is_finished_ = false;
+    uint64_t position_ = 0;
+    uint64_t array_remaining_ = 0;
+
+    void WriteBytes(const void* data, size_t size);
+    void Align();
+};
+
+// Файл снимка, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+template <typename T>
+struct ArrayView {
+    const T* data = nullptr;
+    size_t size = 0;
+};
+
+// Читает массивы снимка в том порядке, в котором они записаны; проверяет границы и типы
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const MappedFile& file);
+
+    template <typename T>
+    ArrayView<T> ReadArray();
+    StringTable ReadStrings();
+
+    // Проверяет, что прочитаны все массивы снимка
+    void Finish() const;
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t position_;
+
+    const char* ReadArrayData(size_t element_size, size_t alignment, size_t& count);
+};
+
+template <typename T>
+void SnapshotWriter::BeginArray(size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>, "Snapshot arrays hold only trivially copyable values");
+    if (array_remaining_ != 0) {
+        throw std::logic_error("Предыдущий массив снимка записан не полностью"s);
+    }
+    const uint64_t header[2] = {count, sizeof(T)};
+    WriteBytes(header, sizeof(header));
+    array_remaining_ = count;
+}
+
+template <typename T>
+void SnapshotWriter::Append(const T* data, size_t count) {
+    if (count > array_remaining_) {
+        throw std::logic_error("Массив снимка длиннее объявленного"s);
+    }
+    WriteBytes(data, count * sizeof(T));
+    array_remaining_ -= count;
+}
+
+template <typename T>
+void SnapshotWriter::WriteArray(const std::vector<T>& data) {
+    BeginArray<T>(data.size());
+    Append(data.data(), data.size());
+    EndArray();
+}
+
+template <typename StringContainer>
+void SnapshotWriter::WriteStrings(const StringContainer& strings) {
+    std::vector<uint64_t> offsets{0};
+    for (const std::string_view str : strings) {
+        offsets.push_back(offsets.back() + str.size());
+    }
+    BeginArray<char>(offsets.back());
+    for (const std::string_view str : strings) {
+        Append(str.data(), str.size());
+    }
+    EndArray();
+    WriteArray(offsets);
+}
+
+template <typename T>
+ArrayView<T> SnapshotReader::ReadArray() {
+    static_assert(std::is_trivially_copyable_v<T>, "Snapshot arrays hold only trivially copyable values");
+    size_t count = 0;
+    const char* data = ReadArrayData(sizeof(T), alignof(T), count);
+    return {reinterpret_cast<const T*>(data), count};
+}
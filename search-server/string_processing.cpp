@@ -4,12 +4,8 @@ using namespace std;
 
 std::vector<std::string_view> SplitIntoWords(std::string_view str) {
     std::vector<std::string_view> words;
-    int64_t pos = str.find_first_not_of(" ");
-    const int64_t pos_end = str.npos;
-    while (pos != pos_end) {
-        int64_t space = str.find(' ', pos);
-        words.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
-        pos = str.find_first_not_of(" ", space);
-    }
+    ForEachWord(str, [&words](std::string_view word) {
+        words.push_back(word);
+    });
     return words;
 }
\ No newline at end of file
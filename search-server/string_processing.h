@@ -1,10 +1,22 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Вызывает callback(word) для каждого слова текста по очереди, не собирая слова в вектор
+template <typename Callback>
+void ForEachWord(std::string_view text, Callback callback) {
+    size_t pos = text.find_first_not_of(' ');
+    while (pos != text.npos) {
+        const size_t space = text.find(' ', pos);
+        callback(text.substr(pos, space == text.npos ? text.npos : space - pos));
+        pos = text.find_first_not_of(' ', space);
+    }
+}
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
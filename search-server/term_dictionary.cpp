@@ -0,0 +1,119 @@
+#include "term_dictionary.h"
+#include <algorithm>
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// Хеш записывается в снимок, поэтому он не должен зависеть от реализации std::hash
+uint64_t HashTerm(string_view word) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+}  // namespace
+
+uint32_t TermDictionary::Intern(string_view word) {
+    const uint32_t found = Find(word);
+    if (found != NO_TERM) {
+        return found;
+    }
+    const uint32_t term_id = static_cast<uint32_t>(size());
+    const string_view stored = StoreInArena(word);
+    terms_.push_back(stored);
+    term_to_id_.emplace(stored, term_id);
+    return term_id;
+}
+
+uint32_t TermDictionary::Find(string_view word) const {
+    if (mapped_count_ > 0) {
+        const uint32_t term_id = FindMapped(word);
+        if (term_id != NO_TERM) {
+            return term_id;
+        }
+    }
+    const auto it = term_to_id_.find(word);
+    return it == term_to_id_.end() ? NO_TERM : it->second;
+}
+
+string_view TermDictionary::GetTerm(uint32_t term_id) const {
+    if (term_id < mapped_count_) {
+        return mapped_terms_[term_id];
+    }
+    return terms_.at(term_id - mapped_count_);
+}
+
+size_t TermDictionary::size() const {
+    return mapped_count_ + terms_.size();
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    vector<string_view> terms(size());
+    for (uint32_t term_id = 0; term_id < terms.size(); ++term_id) {
+        terms[term_id] = GetTerm(term_id);
+    }
+    writer.WriteStrings(terms);
+
+    size_t capacity = 16;
+    while (capacity < terms.size() * 2) {
+        capacity *= 2;
+    }
+    vector<uint32_t> table(capacity, NO_TERM);
+    for (uint32_t term_id = 0; term_id < terms.size(); ++term_id) {
+        size_t index = HashTerm(terms[term_id]) & (capacity - 1);
+        while (table[index] != NO_TERM) {
+            index = (index + 1) & (capacity - 1);
+        }
+        table[index] = term_id;
+    }
+    writer.WriteArray(table);
+}
+
+void TermDictionary::Attach(SnapshotReader& reader) {
+    if (size() > 0) {
+        throw logic_error("Снимок подключается только к пустому словарю"s);
+    }
+    const StringTable terms = reader.ReadStrings();
+    const auto table = reader.ReadArray<uint32_t>();
+    if (table.size == 0 || (table.size & (table.size - 1)) != 0 || table.size <= terms.count) {
+        throw runtime_error("Снимок повреждён: неверная таблица слов"s);
+    }
+    for (size_t i = 0; i < table.size; ++i) {
+        if (table.data[i] != NO_TERM && table.data[i] >= terms.count) {
+            throw runtime_error("Снимок повреждён: неверная таблица слов"s);
+        }
+    }
+    mapped_terms_ = terms;
+    mapped_table_ = table.data;
+    mapped_table_mask_ = table.size - 1;
+    mapped_count_ = static_cast<uint32_t>(terms.count);
+}
+
+uint32_t TermDictionary::FindMapped(string_view word) const {
+    for (size_t index = HashTerm(word) & mapped_table_mask_;; index = (index + 1) & mapped_table_mask_) {
+        const uint32_t term_id = mapped_table_[index];
+        if (term_id == NO_TERM || mapped_terms_[term_id] == word) {
+            return term_id;
+        }
+    }
+}
+
+string_view TermDictionary::StoreInArena(string_view word) {
+    if (word.empty()) {
+        return {};
+    }
+    if (block_capacity_ - block_used_ < word.size()) {
+        block_capacity_ = max(BLOCK_SIZE, word.size());
+        blocks_.push_back(make_unique<char[]>(block_capacity_));
+        block_used_ = 0;
+    }
+    char* data = blocks_.back().get() + block_used_;
+    copy(word.begin(), word.end(), data);
+    block_used_ += word.size();
+    return {data, word.size()};
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "snapshot.h"
+
+// Словарь слов индекса: каждому слову один раз назначается плотный id,
+// сами строки хранятся в арене и не перемещаются, пока жив словарь.
+// Слова из снимка читаются прямо из отображённого файла; новые слова добавляются поверх них
+class TermDictionary {
+public:
+    static constexpr uint32_t NO_TERM = std::numeric_limits<uint32_t>::max();
+
+    // Возвращает id слова, при необходимости добавляя его в словарь
+    uint32_t Intern(std::string_view word);
+    // Возвращает id слова или NO_TERM, не выделяя память
+    uint32_t Find(std::string_view word) const;
+    std::string_view GetTerm(uint32_t term_id) const;
+
+    size_t size() const;
+
+    // Записывает слова вместе с хеш-таблицей, по которой их можно искать, не строя словарь заново
+    void Save(SnapshotWriter& writer) const;
+    // Подключает слова из снимка к пустому словарю; файл снимка должен жить дольше словаря
+    void Attach(SnapshotReader& reader);
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::string_view StoreInArena(std::string_view word);
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t block_used_ = 0;
+    size_t block_capacity_ = 0;
+    std::unordered_map<std::string_view, uint32_t> term_to_id_;
+    // Слова с id не меньше mapped_count_
+    std::vector<std::string_view> terms_;
+
+    // Слова из снимка и хеш-таблица их id с открытой адресацией
+    StringTable mapped_terms_;
+    const uint32_t* mapped_table_ = nullptr;
+    size_t mapped_table_mask_ = 0;
+    uint32_t mapped_count_ = 0;
+
+    uint32_t FindMapped(std::string_view word) const;
+};
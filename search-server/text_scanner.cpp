@@ -0,0 +1,189 @@
+#include "text_scanner.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TEXT_SCANNER_HAS_AVX2
+#endif
+
+using namespace std;
+
+namespace {
+
+const size_t SCAN_BLOCK_SIZE = 64;
+
+// Бит i маски относится к байту i блока
+struct BlockMasks {
+    uint64_t spaces;
+    uint64_t controls;
+};
+
+// Обрабатывает и неполный блок в конце текста
+BlockMasks ScanScalar(const char* data, size_t size) {
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        masks.spaces |= static_cast<uint64_t>(c == ' ') << i;
+        masks.controls |= static_cast<uint64_t>(c < ' ') << i;
+    }
+    return masks;
+}
+
+BlockMasks ScanBlockScalar(const char* data) {
+    return ScanScalar(data, SCAN_BLOCK_SIZE);
+}
+
+#ifdef __SSE2__
+BlockMasks ScanBlockSse2(const char* data) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i max_control = _mm_set1_epi8(' ' - 1);
+    BlockMasks masks{0, 0};
+    for (size_t offset = 0; offset < SCAN_BLOCK_SIZE; offset += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+        // Беззнаковое сравнение c <= 31: min(c, 31) == c
+        const uint32_t spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)));
+        const uint32_t controls = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, max_control), bytes)));
+        masks.spaces |= static_cast<uint64_t>(spaces) << offset;
+        masks.controls |= static_cast<uint64_t>(controls) << offset;
+    }
+    return masks;
+}
+#endif
+
+#ifdef TEXT_SCANNER_HAS_AVX2
+__attribute__((target("avx2"))) BlockMasks ScanBlockAvx2(const char* data) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i max_control = _mm256_set1_epi8(' ' - 1);
+    BlockMasks masks{0, 0};
+    for (size_t offset = 0; offset < SCAN_BLOCK_SIZE; offset += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+        const uint32_t spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)));
+        const uint32_t controls = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(bytes, max_control), bytes)));
+        masks.spaces |= static_cast<uint64_t>(spaces) << offset;
+        masks.controls |= static_cast<uint64_t>(controls) << offset;
+    }
+    return masks;
+}
+#endif
+
+// Встраивается вместе с ScanBlock в функцию каждой реализации, в том числе собранную для AVX2.
+// words == nullptr — только проверка
+template <typename ScanBlock>
+__attribute__((always_inline)) inline bool Tokenize(string_view text, vector<string_view>* words, ScanBlock scan_block) {
+    const char* data = text.data();
+    // Перед текстом как будто стоит пробел, поэтому непробел в начале открывает слово
+    uint64_t previous_space = 1;
+    size_t word_begin = 0;
+    for (size_t block = 0; block < text.size(); block += SCAN_BLOCK_SIZE) {
+        const size_t count = min(SCAN_BLOCK_SIZE, text.size() - block);
+        const BlockMasks masks = count == SCAN_BLOCK_SIZE ? scan_block(data + block) : ScanScalar(data + block, count);
+        if (masks.controls != 0) {
+            return false;
+        }
+        if (words == nullptr) {
+            continue;
+        }
+        // За концом текста — пробелы: они закрывают последнее слово
+        const uint64_t spaces = count == SCAN_BLOCK_SIZE ? masks.spaces : masks.spaces | (~uint64_t{0} << count);
+        // Граница — байт, который отличается от предыдущего: непробел начинает слово, пробел заканчивает
+        uint64_t boundaries = spaces ^ ((spaces << 1) | previous_space);
+        while (boundaries != 0) {
+            const size_t offset = static_cast<size_t>(__builtin_ctzll(boundaries));
+            const size_t pos = block + offset;
+            if ((spaces >> offset) & 1) {
+                words->emplace_back(data + word_begin, pos - word_begin);
+            } else {
+                word_begin = pos;
+            }
+            boundaries &= boundaries - 1;
+        }
+        previous_space = spaces >> (SCAN_BLOCK_SIZE - 1);
+    }
+    if (words != nullptr && previous_space == 0) {
+        words->emplace_back(data + word_begin, text.size() - word_begin);
+    }
+    return true;
+}
+
+bool TokenizeScalar(string_view text, vector<string_view>* words) {
+    return Tokenize(text, words, ScanBlockScalar);
+}
+
+#ifdef __SSE2__
+bool TokenizeSse2(string_view text, vector<string_view>* words) {
+    return Tokenize(text, words, ScanBlockSse2);
+}
+#endif
+
+#ifdef TEXT_SCANNER_HAS_AVX2
+__attribute__((target("avx2"))) bool TokenizeAvx2(string_view text, vector<string_view>* words) {
+    return Tokenize(text, words, ScanBlockAvx2);
+}
+#endif
+
+bool TokenizeWith(TextScanKernel kernel, string_view text, vector<string_view>* words) {
+    switch (kernel) {
+#ifdef TEXT_SCANNER_HAS_AVX2
+        case TextScanKernel::AVX2:
+            return TokenizeAvx2(text, words);
+#endif
+#ifdef __SSE2__
+        case TextScanKernel::SSE2:
+            return TokenizeSse2(text, words);
+#endif
+        default:
+            return TokenizeScalar(text, words);
+    }
+}
+
+}  // namespace
+
+bool IsTextScanKernelSupported(TextScanKernel kernel) {
+    switch (kernel) {
+        case TextScanKernel::SCALAR:
+            return true;
+        case TextScanKernel::SSE2:
+#ifdef __SSE2__
+            return true;
+#else
+            return false;
+#endif
+        case TextScanKernel::AVX2:
+#ifdef TEXT_SCANNER_HAS_AVX2
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+TextScanKernel GetBestTextScanKernel() {
+    static const TextScanKernel kernel = [] {
+        for (const TextScanKernel kernel : {TextScanKernel::AVX2, TextScanKernel::SSE2}) {
+            if (IsTextScanKernelSupported(kernel)) {
+                return kernel;
+            }
+        }
+        return TextScanKernel::SCALAR;
+    }();
+    return kernel;
+}
+
+bool TokenizeText(string_view text, vector<string_view>& words) {
+    return TokenizeWith(GetBestTextScanKernel(), text, &words);
+}
+
+bool TokenizeText(TextScanKernel kernel, string_view text, vector<string_view>& words) {
+    return TokenizeWith(IsTextScanKernelSupported(kernel) ? kernel : TextScanKernel::SCALAR, text, &words);
+}
+
+bool IsValidText(string_view text) {
+    return TokenizeWith(GetBestTextScanKernel(), text, nullptr);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+// Разбор текста документа за один проход: поиск управляющих символов (коды 0–31)
+// и границ слов по пробелам. Текст просматривается блоками по 64 байта, для блока строятся
+// битовые маски пробелов и управляющих символов, а границы слов извлекаются из маски пробелов.
+// Маски строятся SSE2 или AVX2, реализация выбирается при запуске по возможностям процессора
+enum class TextScanKernel {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// Самая быстрая реализация, доступная на этом процессоре
+TextScanKernel GetBestTextScanKernel();
+bool IsTextScanKernelSupported(TextScanKernel kernel);
+
+// Дописывает в words слова текста — то же, что SplitIntoWords, — и проверяет, что в тексте
+// нет управляющих символов, как SearchServer::IsValidWord. Если такой символ есть,
+// возвращает false, а words заполнен не до конца
+bool TokenizeText(std::string_view text, std::vector<std::string_view>& words);
+// Неподдерживаемая процессором реализация заменяется скалярной
+bool TokenizeText(TextScanKernel kernel, std::string_view text, std::vector<std::string_view>& words);
+
+// Только проверка на управляющие символы
+bool IsValidText(std::string_view text);
@@ -0,0 +1,132 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    thread_count = max<size_t>(thread_count, 1);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i] { Run(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard lock(state_mutex_);
+        is_stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return threads_.size();
+}
+
+void ThreadPool::Submit(function<void()> task) {
+    Worker& worker = *workers_[next_worker_.fetch_add(1, memory_order_relaxed) % workers_.size()];
+    {
+        // Счётчик меняется под мьютексом очереди, как и в TryPop, поэтому задачу
+        // не заберут раньше, чем она будет учтена
+        lock_guard lock(worker.mutex);
+        worker.tasks.push_back(move(task));
+        lock_guard state_lock(state_mutex_);
+        ++pending_count_;
+    }
+    has_tasks_.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, const function<void(size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    // Несколько частей на поток, чтобы было что красть, когда части неравны по времени
+    const size_t chunk_count = min(count, GetThreadCount() * 8);
+    mutex done_mutex;
+    condition_variable done;
+    size_t remaining = chunk_count;
+    exception_ptr error;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        Submit([&, chunk] {
+            try {
+                for (size_t i = count * chunk / chunk_count; i < count * (chunk + 1) / chunk_count; ++i) {
+                    body(i);
+                }
+            } catch (...) {
+                lock_guard lock(done_mutex);
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+            lock_guard lock(done_mutex);
+            if (--remaining == 0) {
+                done.notify_all();
+            }
+        });
+    }
+    while (RunPendingTask()) {
+    }
+    unique_lock lock(done_mutex);
+    done.wait(lock, [&remaining] {
+        return remaining == 0;
+    });
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+bool ThreadPool::RunPendingTask() {
+    function<void()> task;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (TryPop(i, task)) {
+            task();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::TryPop(size_t worker_index, function<void()>& task) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        Worker& worker = *workers_[(worker_index + i) % workers_.size()];
+        lock_guard lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = move(worker.tasks.front());
+            worker.tasks.pop_front();
+        } else {
+            task = move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+        lock_guard state_lock(state_mutex_);
+        --pending_count_;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::Run(size_t worker_index) {
+    function<void()> task;
+    while (true) {
+        if (TryPop(worker_index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        unique_lock lock(state_mutex_);
+        has_tasks_.wait(lock, [this] {
+            return is_stopping_ || pending_count_ > 0;
+        });
+        if (is_stopping_ && pending_count_ == 0) {
+            return;
+        }
+    }
+}
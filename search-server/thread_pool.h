@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков, которые живут между пакетами задач, поэтому потоковые буферы
+// (например, QueryScratch) переиспользуются. У каждого потока своя очередь: поток берёт задачи
+// из её начала, а когда она пуста, крадёт задачи с конца чужих очередей
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+    // Дожидается выполнения всех поставленных задач
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t GetThreadCount() const;
+
+    // Ставит задачу в очередь одного из потоков. Задача не должна бросать исключений
+    void Submit(std::function<void()> task);
+
+    // Выполняет body(i) для всех i из [0, count) и возвращает управление, когда все вызовы
+    // завершены. Пока ждёт, вызывающий поток сам выполняет задачи из очередей.
+    // Первое исключение из body перебрасывается после завершения остальных вызовов
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // Выполняет одну задачу из любой очереди; false — очереди пусты
+    bool RunPendingTask();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_worker_{0};
+
+    // Число задач в очередях; потоки засыпают, когда оно равно нулю
+    std::mutex state_mutex_;
+    std::condition_variable has_tasks_;
+    size_t pending_count_ = 0;
+    bool is_stopping_ = false;
+
+    bool TryPop(size_t worker_index, std::function<void()>& task);
+    void Run(size_t worker_index);
+};
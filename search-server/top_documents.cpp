@@ -0,0 +1,44 @@
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < SET_PRECISION) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Память не резервируется заранее: top_count может быть огромным (например, SIZE_MAX — «все документы»),
+// а куча растёт только по мере поступления документов
+TopDocuments::TopDocuments(size_t capacity) : capacity_(capacity) {
+}
+
+void TopDocuments::Push(const Document& document) {
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    } else if (capacity_ > 0 && IsMoreRelevant(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+bool TopDocuments::IsFull() const {
+    // Куча нулевой ёмкости не бывает полной: у неё нет худшего документа
+    return capacity_ > 0 && heap_.size() == capacity_;
+}
+
+const Document& TopDocuments::Worst() const {
+    return heap_.front();
+}
+
+vector<Document> TopDocuments::Extract() {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    vector<Document> result = move(heap_);
+    heap_.clear();
+    return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <vector>
+#include "document.h"
+
+const double SET_PRECISION = 1e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной релевантности — по убыванию рейтинга
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+// Ограниченная куча, хранящая не более capacity лучших документов
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity);
+
+    void Push(const Document& document);
+
+    bool IsFull() const;
+    // Худший из отобранных документов, определён только для непустой кучи
+    const Document& Worst() const;
+
+    // Возвращает отобранные документы в порядке выдачи и опустошает кучу
+    std::vector<Document> Extract();
+
+private:
+    size_t capacity_;
+    std::vector<Document> heap_;
+};
+
+// Оставляет в documents top_count лучших документов в порядке выдачи
+template <typename ExecutionPolicy>
+void SelectTopDocuments(ExecutionPolicy policy, std::vector<Document>& documents, size_t top_count) {
+    if (documents.size() > top_count) {
+        std::partial_sort(policy, documents.begin(), documents.begin() + top_count, documents.end(), IsMoreRelevant);
+        documents.resize(top_count);
+    } else {
+        std::sort(policy, documents.begin(), documents.end(), IsMoreRelevant);
+    }
+}
@@ -0,0 +1,269 @@
+#include "write_ahead_log.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Заголовок записи: длина данных, CRC32 номера, типа и данных, номер, тип
+const size_t HEADER_SIZE = 4 + 4 + 8 + 1;
+const size_t MAX_PAYLOAD_SIZE = 1u << 30;
+
+array<uint32_t, 256> MakeCrcTable() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint32_t ComputeCrc(string_view data) {
+    static const array<uint32_t, 256> table = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+template <typename T>
+void AppendValue(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Читает значения подряд; при выходе за границу записи запоминает ошибку и возвращает нули
+class RecordReader {
+public:
+    RecordReader(string_view data, size_t pos)
+            : data_(data)
+            , pos_(pos) {
+    }
+
+    template <typename T>
+    T Read() {
+        T value{};
+        if (data_.size() - pos_ < sizeof(T)) {
+            is_failed_ = true;
+            return value;
+        }
+        memcpy(&value, data_.data() + pos_, sizeof(value));
+        pos_ += sizeof(value);
+        return value;
+    }
+
+    string_view ReadBytes(size_t size) {
+        if (data_.size() - pos_ < size) {
+            is_failed_ = true;
+            return {};
+        }
+        pos_ += size;
+        return data_.substr(pos_ - size, size);
+    }
+
+    // Запись прочитана целиком и без ошибок
+    bool IsComplete() const {
+        return !is_failed_ && pos_ == data_.size();
+    }
+
+private:
+    string_view data_;
+    size_t pos_;
+    bool is_failed_ = false;
+};
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const string& path, const LogContents& contents, uint64_t last_sequence_number)
+        : last_sequence_number_(last_sequence_number)
+        , durable_sequence_number_(last_sequence_number)
+        , durable_size_(contents.valid_size) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        throw runtime_error("Не удалось открыть журнал "s + path);
+    }
+    if (ftruncate(fd_, static_cast<off_t>(contents.valid_size)) != 0 || fdatasync(fd_) != 0) {
+        close(fd_);
+        throw runtime_error("Не удалось обрезать журнал "s + path);
+    }
+    if (!contents.records.empty()) {
+        last_sequence_number_ = max(last_sequence_number_, contents.records.back().sequence_number);
+        durable_sequence_number_ = last_sequence_number_;
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        Sync();
+    } catch (...) {
+    }
+    close(fd_);
+}
+
+uint64_t WriteAheadLog::LogAddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    string payload;
+    payload.reserve(16 + ratings.size() * sizeof(int) + document.size());
+    AppendValue<int32_t>(payload, document_id);
+    AppendValue<int32_t>(payload, static_cast<int32_t>(status));
+    AppendValue<uint32_t>(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        AppendValue<int32_t>(payload, rating);
+    }
+    AppendValue<uint32_t>(payload, static_cast<uint32_t>(document.size()));
+    payload.append(document);
+    return Append(LogRecord::Type::ADD_DOCUMENT, payload);
+}
+
+uint64_t WriteAheadLog::LogRemoveDocument(int document_id) {
+    string payload;
+    AppendValue<int32_t>(payload, document_id);
+    return Append(LogRecord::Type::REMOVE_DOCUMENT, payload);
+}
+
+void WriteAheadLog::Sync() {
+    uint64_t sequence_number;
+    {
+        lock_guard lock(mutex_);
+        sequence_number = last_sequence_number_;
+    }
+    WaitDurable(sequence_number);
+}
+
+uint64_t WriteAheadLog::Append(LogRecord::Type type, const string& payload) {
+    if (payload.size() > MAX_PAYLOAD_SIZE) {
+        throw invalid_argument("Слишком большая запись журнала"s);
+    }
+    lock_guard lock(mutex_);
+    CheckNotFailed();
+    const uint64_t sequence_number = ++last_sequence_number_;
+    const size_t record_begin = buffer_.size();
+    AppendValue<uint32_t>(buffer_, static_cast<uint32_t>(payload.size()));
+    AppendValue<uint32_t>(buffer_, 0);
+    AppendValue<uint64_t>(buffer_, sequence_number);
+    AppendValue<uint8_t>(buffer_, static_cast<uint8_t>(type));
+    buffer_ += payload;
+    const uint32_t crc = ComputeCrc(string_view(buffer_).substr(record_begin + 8));
+    memcpy(&buffer_[record_begin + 4], &crc, sizeof(crc));
+    return sequence_number;
+}
+
+void WriteAheadLog::CheckNotFailed() const {
+    if (is_failed_) {
+        throw runtime_error("Журнал недоступен после ошибки записи"s);
+    }
+}
+
+// Групповая фиксация: один из ждущих потоков забирает весь буфер и делает fsync,
+// остальные ждут его результата, и запись каждого из них оказывается на диске вместе с остальными
+void WriteAheadLog::WaitDurable(uint64_t sequence_number) {
+    unique_lock lock(mutex_);
+    while (durable_sequence_number_ < sequence_number) {
+        CheckNotFailed();
+        if (is_syncing_) {
+            synced_.wait(lock);
+            continue;
+        }
+        is_syncing_ = true;
+        string batch;
+        batch.swap(buffer_);
+        const uint64_t batch_sequence_number = last_sequence_number_;
+        lock.unlock();
+        try {
+            WriteToDisk(batch);
+        } catch (...) {
+            // Группа возвращается в буфер, а оборванный её хвост — отрезается от файла, чтобы
+            // неподтверждённые записи не применились при восстановлении. После неудачного fsync
+            // состояние страниц файла неизвестно, поэтому повторять запись нельзя
+            lock.lock();
+            buffer_.insert(0, batch);
+            if (ftruncate(fd_, static_cast<off_t>(durable_size_)) != 0) {
+                // Остаётся только сообщить об исходной ошибке
+            }
+            is_failed_ = true;
+            is_syncing_ = false;
+            synced_.notify_all();
+            throw;
+        }
+        lock.lock();
+        durable_size_ += batch.size();
+        is_syncing_ = false;
+        durable_sequence_number_ = batch_sequence_number;
+        synced_.notify_all();
+    }
+}
+
+void WriteAheadLog::WriteToDisk(const string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t result = write(fd_, data.data() + written, data.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("Ошибка записи журнала: "s + strerror(errno));
+        }
+        written += static_cast<size_t>(result);
+    }
+    if (fdatasync(fd_) != 0) {
+        throw runtime_error("Ошибка сброса журнала на диск: "s + strerror(errno));
+    }
+}
+
+string WriteAheadLog::ReadFile(const string& path) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        return {};
+    }
+    return {istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+}
+
+vector<WriteAheadLog::RecordBounds> WriteAheadLog::SplitRecords(string_view data) {
+    vector<RecordBounds> bounds;
+    size_t pos = 0;
+    while (data.size() - pos >= HEADER_SIZE) {
+        uint32_t payload_size;
+        memcpy(&payload_size, data.data() + pos, sizeof(payload_size));
+        if (payload_size > MAX_PAYLOAD_SIZE || data.size() - pos - HEADER_SIZE < payload_size) {
+            break;
+        }
+        bounds.push_back({pos, pos + HEADER_SIZE + payload_size});
+        pos = bounds.back().end;
+    }
+    return bounds;
+}
+
+bool WriteAheadLog::DecodeRecord(string_view record, LogRecord& result) {
+    RecordReader reader(record, 4);
+    const uint32_t crc = reader.Read<uint32_t>();
+    if (ComputeCrc(record.substr(8)) != crc) {
+        return false;
+    }
+    result.sequence_number = reader.Read<uint64_t>();
+    result.type = static_cast<LogRecord::Type>(reader.Read<uint8_t>());
+    result.document_id = reader.Read<int32_t>();
+    if (result.type == LogRecord::Type::ADD_DOCUMENT) {
+        result.status = static_cast<DocumentStatus>(reader.Read<int32_t>());
+        const uint32_t rating_count = reader.Read<uint32_t>();
+        if (rating_count > record.size() / sizeof(int32_t)) {
+            return false;
+        }
+        result.ratings.resize(rating_count);
+        for (int& rating : result.ratings) {
+            rating = reader.Read<int32_t>();
+        }
+        result.document = reader.ReadBytes(reader.Read<uint32_t>());
+    } else if (result.type != LogRecord::Type::REMOVE_DOCUMENT) {
+        return false;
+    }
+    return reader.IsComplete();
+}
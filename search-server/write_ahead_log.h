@@ -0,0 +1,123 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+// Запись журнала. Текст документа указывает в LogContents::data
+struct LogRecord {
+    enum class Type : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+    };
+
+    uint64_t sequence_number = 0;
+    Type type = Type::ADD_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view document;
+};
+
+// Прочитанный с диска журнал
+struct LogContents {
+    std::string data;
+    std::vector<LogRecord> records;
+    // Длина неповреждённого начала журнала: оборванный при сбое хвост отбрасывается
+    size_t valid_size = 0;
+};
+
+// Журнал изменений индекса, в который записи только дописываются. Каждая запись
+// снабжена номером и контрольной суммой. Записи копятся в буфере, и изменение считается
+// подтверждённым, только когда WaitDurable с номером его записи вернул управление.
+// Фиксация групповая: первый ждущий поток пишет весь накопленный буфер и делает один fsync,
+// а записи, добавленные другими потоками за это время, уходят на диск следующей группой.
+// Группа ничем не ограничена, кроме числа записей, накопленных за время одного fsync.
+// Если запись на диск не удалась, файл обрезается до последней зафиксированной записи
+// и журнал переходит в состояние ошибки: неподтверждённые записи на диск уже не попадут,
+// и все дальнейшие вызовы бросают исключение
+class WriteAheadLog {
+public:
+    // Продолжает журнал после contents, обрезая повреждённый хвост;
+    // новые записи получают номера больше last_sequence_number
+    WriteAheadLog(const std::string& path, const LogContents& contents, uint64_t last_sequence_number);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Добавляют запись в буфер и возвращают её номер; на диске она будет после WaitDurable или Sync
+    uint64_t LogAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    uint64_t LogRemoveDocument(int document_id);
+
+    // Дожидается, пока запись с номером sequence_number и все предыдущие окажутся на диске
+    void WaitDurable(uint64_t sequence_number);
+    // Дожидается, пока все записанные до вызова записи окажутся на диске
+    void Sync();
+
+    // Читает журнал; контрольные суммы проверяются и записи разбираются параллельно.
+    // Отсутствующий файл — пустой журнал
+    template <typename ExecutionPolicy>
+    static LogContents Read(ExecutionPolicy policy, const std::string& path);
+
+private:
+    struct RecordBounds {
+        size_t begin;
+        size_t end;
+    };
+
+    int fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable synced_;
+    std::string buffer_;
+    uint64_t last_sequence_number_;
+    uint64_t durable_sequence_number_;
+    // Длина зафиксированного начала файла: до неё файл обрезается после неудачной записи
+    uint64_t durable_size_;
+    bool is_syncing_ = false;
+    bool is_failed_ = false;
+
+    uint64_t Append(LogRecord::Type type, const std::string& payload);
+    void CheckNotFailed() const;
+    void WriteToDisk(const std::string& data);
+
+    static std::string ReadFile(const std::string& path);
+    static std::vector<RecordBounds> SplitRecords(std::string_view data);
+    // Проверяет контрольную сумму и разбирает запись; false — запись повреждена
+    static bool DecodeRecord(std::string_view record, LogRecord& result);
+};
+
+template <typename ExecutionPolicy>
+LogContents WriteAheadLog::Read(ExecutionPolicy policy, const std::string& path) {
+    LogContents contents;
+    contents.data = ReadFile(path);
+    const std::string_view data = contents.data;
+    std::vector<RecordBounds> bounds = SplitRecords(data);
+
+    contents.records.resize(bounds.size());
+    std::vector<char> is_valid(bounds.size());
+    std::vector<size_t> indexes(bounds.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        is_valid[i] = DecodeRecord(data.substr(bounds[i].begin, bounds[i].end - bounds[i].begin), contents.records[i]);
+    });
+    // Журнал обрезается по первой повреждённой записи. Номера записей возрастают,
+    // запись с меньшим номером — остаток старых данных после сбоя
+    size_t valid_count = 0;
+    while (valid_count < bounds.size() && is_valid[valid_count]
+           && (valid_count == 0 || contents.records[valid_count].sequence_number > contents.records[valid_count - 1].sequence_number)) {
+        ++valid_count;
+    }
+    contents.records.resize(valid_count);
+    bounds.resize(valid_count);
+    contents.valid_size = bounds.empty() ? 0 : bounds.back().end;
+    return contents;
+}